@@ -9,6 +9,11 @@
 #include "SimpleScorer.h"
 #include "GenomeScorer.h"
 #include "Genbank.h"
+#include "Anchors.h"
+#include "MinimizerIndex.h"
+#include "TranslatedIndex.h"
+#include "CodonAligner.h"
+#include "EditDistance.h"
 #include "../args/args.hxx"
 
 #include <fstream>
@@ -199,31 +204,286 @@ void realignGaps(const SimpleScorer<seq::NTSequence>& nucleotideScorer,
   }
 }
 
-template<typename Aligner>
-void runAga(Aligner& aligner, const Genome& ref, const std::string& queriesFile,
-	    Cigar seed, int maxLength,
-	    bool strictCodonBoundaries,
-	    const std::vector<CdsFeature>& proteins,
-	    const std::string& ntAlignmentFile,
-	    const std::string& cdsAlignmentsFile,
-	    const std::string& proteinAlignemntsFile,
-	    const std::string& cdsNtAlignmentsFile,
-	    const std::string& proteinNtAlignemntsFile)
+/*
+ * Chains the anchors of the query into a seed for aligning it against
+ * the reference, or an empty seed if the chain is too short to be
+ * trusted.
+ */
+Cigar findSeed(const std::vector<Anchor>& anchors, int refSize, int querySize)
+{
+  const int MinSeedLength = 50;
+
+  std::vector<Anchor> chain = chainAnchors(anchors);
+
+  int length = 0;
+  for (const auto& a : chain)
+    length += a.length;
+
+  if (length < MinSeedLength)
+    return Cigar();
+  else
+    return seedCigar(chain, refSize, querySize);
+}
+
+/*
+ * Points at which the alignment of the query can be split into
+ * independent sub-alignments: within the Match items of the seed, in
+ * the middle of an exact match of 2 * SplitFlank nucleotides, at a
+ * codon boundary of all CDS features (so that no codon is cut), and
+ * at least SplitSpacing reference positions apart.
+ */
+std::vector<SplitPoint> findSplitPoints(const Genome& ref,
+					const seq::NTSequence& query,
+					const Cigar& seed)
 {
-  std::ifstream q(queriesFile);
+  const int SplitFlank = 16;
+  const int SplitSpacing = 250;
+
+  std::vector<SplitPoint> result;
+
+  int refI = 0, queryI = 0;
+  int last = -SplitSpacing;
+
+  for (const auto& item : seed) {
+    const int length = item.length();
+
+    switch (item.op()) {
+    case CigarItem::Match: {
+      /* identical positions ending at and starting from k */
+      std::vector<int> before(length), after(length);
+      for (int k = 0; k < length; ++k) {
+	bool same = ref[refI + k] == query[queryI + k];
+	before[k] = same ? (k > 0 ? before[k - 1] : 0) + 1 : 0;
+      }
+      for (int k = length - 1; k >= 0; --k) {
+	bool same = ref[refI + k] == query[queryI + k];
+	after[k] = same ? (k < length - 1 ? after[k + 1] : 0) + 1 : 0;
+      }
+
+      for (int k = 0; k + 1 < length; ++k) {
+	const int r = refI + k;
+	if (r - last < SplitSpacing
+	    || before[k] < SplitFlank || after[k + 1] < SplitFlank)
+	  continue;
+
+	bool codonEnd = true;
+	for (const auto& p : ref.cdsAa(r))
+	  if (p.i != 2)
+	    codonEnd = false;
+
+	if (codonEnd) {
+	  result.push_back(SplitPoint(r, queryI + k));
+	  last = r;
+	}
+      }
+
+      refI += length;
+      queryI += length;
+      break;
+    }
+    case CigarItem::QueryGap:
+    case CigarItem::RefSkipped:
+      refI += length;
+      break;
+    case CigarItem::RefGap:
+    case CigarItem::QuerySkipped:
+      queryI += length;
+      break;
+    default:
+      break;
+    }
+  }
+
+  return result;
+}
+
+template <class Scorer, class Reference, class Query, int SideN,
+	  class Ref, class Qry>
+typename GlobalAligner<Scorer, Reference, Query, SideN>::Solution
+alignContig(GlobalAligner<Scorer, Reference, Query, SideN>& aligner,
+	    const Ref& ref, const Qry& query, const SearchRange& sr,
+	    const std::vector<SplitPoint>& splitPoints)
+{
+  if (splitPoints.empty())
+    return aligner.align(ref, query, sr);
+  else
+    return aligner.alignThrough(ref, query, sr, splitPoints);
+}
+
+/* A local alignment cannot be split */
+template <class Scorer, class Reference, class Query, int SideN,
+	  class Ref, class Qry>
+typename LocalAligner<Scorer, Reference, Query, SideN>::Solution
+alignContig(LocalAligner<Scorer, Reference, Query, SideN>& aligner,
+	    const Ref& ref, const Qry& query, const SearchRange& sr,
+	    const std::vector<SplitPoint>& splitPoints)
+{
+  return aligner.align(ref, query, sr);
+}
+
+template <class Scorer, class Reference, class Query, int SideN>
+int maxWidenedColumns(const GlobalAligner<Scorer, Reference, Query,
+					  SideN>& aligner)
+{
+  return aligner.maxWidenedColumns();
+}
+
+/* A local alignment does not widen its search range */
+template <class Scorer, class Reference, class Query, int SideN>
+int maxWidenedColumns(const LocalAligner<Scorer, Reference, Query,
+					 SideN>& aligner)
+{
+  return 0;
+}
+
+/*
+ * The reference and query positions from the first to the last match
+ * of a seed. Returns false if the seed has no match.
+ */
+bool seedMatches(const Cigar& seed, Range& ref, Range& query)
+{
+  int refStart = -1, queryStart = 0, refEnd = 0, queryEnd = 0;
+  int refI = 0, queryI = 0;
+  for (const auto& item : seed) {
+    switch (item.op()) {
+    case CigarItem::Match:
+      if (refStart < 0) {
+	refStart = refI;
+	queryStart = queryI;
+      }
+      refI += item.length();
+      queryI += item.length();
+      refEnd = refI;
+      queryEnd = queryI;
+      break;
+    case CigarItem::RefGap:
+    case CigarItem::QuerySkipped:
+      queryI += item.length();
+      break;
+    case CigarItem::QueryGap:
+    case CigarItem::RefSkipped:
+      refI += item.length();
+      break;
+    default:
+      break;
+    }
+  }
+
+  if (refStart < 0)
+    return false;
+
+  ref = Range(refStart, refEnd);
+  query = Range(queryStart, queryEnd);
+
+  return true;
+}
+
+/*
+ * The margin of the search range around a seed, from the divergence
+ * of the query from the reference between the first and last match
+ * of the seed, estimated with editDistance(): a similar query stays
+ * close to the diagonals of the seed, a divergent query may wander
+ * further. Returns -1 for a query so divergent that a band is not to
+ * be trusted, which is then aligned with the full matrix.
+ */
+int seedMargin(const seq::NTSequence& ref, const seq::NTSequence& query,
+	       const Cigar& seed, int& divergence)
+{
+  const int MinMargin = 20;
+  const int MarginPerPercent = 10;
+  const int MaxBandedDivergence = 35;
+
+  Range refMatched, queryMatched;
+  if (!seedMatches(seed, refMatched, queryMatched)) {
+    divergence = 0;
+    return MinMargin;
+  }
+
+  seq::NTSequence refWindow(ref.begin() + refMatched.start,
+			    ref.begin() + refMatched.end);
+  seq::NTSequence queryWindow(query.begin() + queryMatched.start,
+			      query.begin() + queryMatched.end);
+
+  divergence = 100 * editDistance(refWindow, queryWindow)
+    / std::max(refWindow.size(), queryWindow.size());
+
+  if (divergence > MaxBandedDivergence)
+    return -1;
+  else
+    return MinMargin + MarginPerPercent * divergence;
+}
+
+/*
+ * The options of a run, which do not depend on the aligner.
+ */
+struct RunOptions {
+  RunOptions()
+    : autoSeed(false),
+      splitAtSeed(false),
+      adaptiveBand(false),
+      refWindow(false),
+      twoPassBand(0),
+      codonPass(false),
+      maxLength(0),
+      strictCodonBoundaries(false)
+  { }
+
+  std::string queriesFile;
+  Cigar seed;
+  std::vector<Anchor> seedAnchors;
+  bool autoSeed, splitAtSeed, adaptiveBand, refWindow;
+  int twoPassBand;
+  bool codonPass;
+  int maxLength;
+  bool strictCodonBoundaries;
+  std::vector<CdsFeature> proteins;
+
+  std::string ntAlignmentFile;
+  std::string cdsAlignmentsFile, cdsNtAlignmentsFile;
+  std::string proteinAlignmentsFile, proteinNtAlignmentsFile;
+};
+
+/*
+ * Aligns the queries using the aligner, for queries of type Query,
+ * and reports the alignment and its statistics using the scorer.
+ */
+template<typename Query, typename Aligner>
+void runAga(Aligner& aligner, const GenomeScorer& scorer,
+	    const Genome& ref, const RunOptions& options)
+{
+  std::ifstream q(options.queriesFile);
+  Cigar seed = options.seed;
 
   bool circular = ref.geometry() == Genome::Geometry::Circular;
       
   Genome linearized;
   if (circular) {
     std::cerr << "Circular" << std::endl;
-    linearized = unwrapLinear(ref, aligner.scorer());
+    linearized = unwrapLinear(ref, scorer);
     aligner.scorer().setScoreRefStartGap(true);
     aligner.scorer().setScoreRefEndGap(true);
     if (!seed.empty())
       seed.unwrap();
   }
 
+  const Genome& target = circular ? linearized : ref;
+
+  /*
+   * The index for --auto-seed is built only when it will be used: it is
+   * no part of the reference for scoring an alignment.
+   */
+  const bool autoSeed
+    = options.autoSeed && seed.empty() && options.seedAnchors.empty();
+
+  MinimizerIndex minimizers;
+  if (autoSeed)
+    minimizers = MinimizerIndex(target);
+
+  /* Amino acid seeds only when the alignment scores amino acids */
+  TranslatedIndex translatedKmers;
+  if (autoSeed && std::is_same<Query, NTSequence6AA>::value)
+    translatedKmers = TranslatedIndex(target);
+
   for (;;) {
     seq::NTSequence query;
     q >> query;
@@ -233,7 +493,24 @@ void runAga(Aligner& aligner, const Genome& ref, const std::string& queriesFile,
 
     removeGaps(query);
 
-    std::vector<Contig> contigs = splitContigs(query, seed);
+    Cigar querySeed = seed;
+    if (querySeed.empty()) {
+      if (!options.seedAnchors.empty())
+	querySeed = findSeed(options.seedAnchors, target.size(), query.size());
+      else if (autoSeed) {
+	/*
+	 * Nucleotide matches, and amino acid matches in the CDS
+	 * features for a divergent query
+	 */
+	std::vector<Anchor> anchors = minimizers.anchors(query);
+	std::vector<Anchor> aaAnchors = translatedKmers.anchors(query);
+	anchors.insert(anchors.end(), aaAnchors.begin(), aaAnchors.end());
+
+	querySeed = findSeed(mergeAnchors(anchors), target.size(), query.size());
+      }
+    }
+
+    std::vector<Contig> contigs = splitContigs(query, querySeed);
 
     LocalAlignments contigAlignments;
 
@@ -246,19 +523,61 @@ void runAga(Aligner& aligner, const Genome& ref, const std::string& queriesFile,
 		<< c.sequence.size() << ") against "
 		<< ref.name() << " (len=" << ref.size() << ")";
       
-      const SearchRange sr = getSearchRange(c.seed,
-					    circular ? linearized.size() : ref.size(),
-					    c.sequence.size());
+      int margin = 150;
+      int divergence = 0;
+      if (options.adaptiveBand && !c.seed.empty())
+	margin = seedMargin(target, c.sequence, c.seed, divergence);
+
+      /*
+       * With a reference window, the contig is aligned against the
+       * part of the reference around its seed only, and the alignment
+       * is shifted back afterwards.
+       */
+      const bool windowed = options.refWindow && margin >= 0 && !c.seed.empty()
+	&& !aligner.scorer().scoreRefStartGap()
+	&& !aligner.scorer().scoreRefEndGap();
+      Range window(0, target.size());
+      Genome windowGenome;
+      Cigar contigSeed = c.seed;
+      if (windowed) {
+	/*
+	 * The window holds the part of the search range in which the
+	 * alignment may leave the first and last row, also after widening
+	 * it, padded on both sides: by the margin, so that getSearchRange()
+	 * finds the same search range within the window, and by a codon,
+	 * since the CDS features are cropped to whole codons.
+	 */
+	getSearchRange(c.seed, target.size(), c.sequence.size(), margin)
+	  .refWindow(margin + maxWidenedColumns(aligner) + 3,
+		     window.start, window.end);
+	windowGenome = cropGenome(target, window.start, window.end, scorer);
+	contigSeed = c.seed.cropRef(window.start, window.end);
+      }
+
+      const Genome& contigTarget = windowed ? windowGenome : target;
+
+      SearchRange sr = getSearchRange(margin < 0 ? Cigar() : contigSeed,
+				      contigTarget.size(), c.sequence.size(),
+				      std::max(0, margin));
 
       if (!c.seed.empty())
 	std::cerr << " using seed of length " << c.seed.queryAlignedPosCount();
       std::cerr << std::endl;
 
+      if (options.adaptiveBand && !c.seed.empty()) {
+	std::cerr << "Divergence " << divergence << "%: ";
+	if (margin < 0)
+	  std::cerr << "full matrix" << std::endl;
+	else
+	  std::cerr << "margin of " << margin << std::endl;
+      }
+
       typename Aligner::Solution solution;
 
-      if (maxLength > 0 && sr.size() > maxLength * maxLength) {
+      if (options.maxLength > 0
+	  && sr.size() > options.maxLength * options.maxLength) {
 	std::cerr << "Not aligning because search range too large "
-		  << sqrt(sr.size()) << " > " << maxLength << std::endl;
+		  << sqrt(sr.size()) << " > " << options.maxLength << std::endl;
 	solution.score = 0;
 	solution.cigar = c.seed;
 	if (solution.cigar.empty()) {
@@ -268,15 +587,94 @@ void runAga(Aligner& aligner, const Genome& ref, const std::string& queriesFile,
       } else if (c.sequence.size() > 0) {	
 	c.sequence.sampleAmbiguities();
 
-	solution = aligner.align(circular ? linearized : ref,
-				 NTSequence6AA(c.sequence), sr);
+	Cigar splitSeed = contigSeed;
+
+	if (options.twoPassBand > 0) {
+	  Cigar firstPass;
+	  if (options.codonPass) {
+	    /*
+	     * A first pass at codon resolution, with a third of the
+	     * cells and explicit frameshifts
+	     */
+	    CodonAligner codonAligner(scorer);
+	    GenomeScorer& codonScorer = codonAligner.scorer();
+	    codonScorer.setScoreRefStartGap(aligner.scorer().scoreRefStartGap());
+	    codonScorer.setScoreRefEndGap(aligner.scorer().scoreRefEndGap());
+
+	    firstPass = codonAligner.align(contigTarget, NTSequence6AA(c.sequence), sr);
+	  } else {
+	    /*
+	     * A first pass with only nucleotide scores, which is cheaper
+	     * (vectorized, without codon states), provides a band for
+	     * the alignment with the full scores.
+	     */
+	    SimpleScorer<seq::NTSequence> ntScorer = scorer.nucleotideScorer();
+	    ntScorer.setScoreRefStartGap(aligner.scorer().scoreRefStartGap());
+	    ntScorer.setScoreRefEndGap(aligner.scorer().scoreRefEndGap());
+
+	    GlobalAligner<SimpleScorer<seq::NTSequence>, seq::NTSequence,
+			  seq::NTSequence, SimpleScorer<seq::NTSequence>::SideN>
+	      ntAligner(ntScorer);
+
+	    firstPass = ntAligner.align(contigTarget, c.sequence, sr).cigar;
+	  }
+
+	  if (!firstPass.empty()) {
+	    sr = getSearchRange(bandSeed(firstPass), contigTarget.size(),
+				c.sequence.size(), options.twoPassBand);
+	    splitSeed = firstPass;
+
+	    std::cerr << "Two-pass: band of " << options.twoPassBand
+		      << " around the "
+		      << (options.codonPass ? "codon" : "nucleotide")
+		      << " alignment (" << sr.size() << " cells)" << std::endl;
+	  }
+	}
+
+	std::vector<SplitPoint> splitPoints;
+	if (options.splitAtSeed) {
+	  splitPoints = findSplitPoints(contigTarget, c.sequence, splitSeed);
+	  if (!splitPoints.empty())
+	    std::cerr << "Split at " << splitPoints.size()
+		      << " seed matches" << std::endl;
+	}
+
+	solution = alignContig(aligner, contigTarget, Query(c.sequence), sr,
+			       splitPoints);
+
+	if (windowed) {
+	  Cigar shifted;
+	  shifted.push_back(CigarItem(CigarItem::RefSkipped, window.start));
+	  shifted.insert(shifted.end(),
+			 solution.cigar.begin(), solution.cigar.end());
+
+	  /* Before the unaligned end of the query, as without a window */
+	  auto end = shifted.end();
+	  while (end != shifted.begin()
+		 && (end - 1)->op() == CigarItem::QuerySkipped)
+	    --end;
+	  shifted.insert(end, CigarItem(CigarItem::RefSkipped,
+					target.size() - window.end));
+	  shifted.makeCanonical();
+	  solution.cigar = shifted;
+
+	  /* In the score units of the whole reference */
+	  solution.score *= target.scoreFactor() / windowGenome.scoreFactor();
+
+	  std::cerr << "Aligned against the window " << window.start + 1
+		    << "-" << window.end << std::endl;
+	}
 
-	if (!strictCodonBoundaries) {
+	if (aligner.stripeColumns() > 0)
+	  std::cerr << "Computed in stripes of " << aligner.stripeColumns()
+		    << " columns" << std::endl;
+
+	if (!options.strictCodonBoundaries) {
 	  seq::NTSequence seq1 = circular ? linearized : ref;
 	  seq::NTSequence seq2 = c.sequence;
 	  solution.cigar.align(seq1, seq2);
 
-	  realignGaps(aligner.scorer().nucleotideScorer(), seq1, seq2);
+	  realignGaps(scorer.nucleotideScorer(), seq1, seq2);
 	  solution.cigar = Cigar::createFromAlignment(seq1, seq2);
 	}
 
@@ -313,14 +711,14 @@ void runAga(Aligner& aligner, const Genome& ref, const std::string& queriesFile,
     }
     
     solution.cigar.removeUnalignedQuery(query);
-    saveSolution(solution.cigar, ref, query, ntAlignmentFile);
+    saveSolution(solution.cigar, ref, query, options.ntAlignmentFile);
 
     /*
      * Everything below here just provides the amino acid alignments
      * and statistics
      */
     auto ntStats = calcStats(ref, query, solution.cigar,
-			     aligner.scorer().nucleotideScorer());
+			     scorer.nucleotideScorer());
 
     std::cout << std::endl << "NT alignment: " << ntStats << std::endl;
 
@@ -328,18 +726,18 @@ void runAga(Aligner& aligner, const Genome& ref, const std::string& queriesFile,
       std::vector<CDSAlignment> aaAlignments
 	= getCDSAlignments(ref, ref.cdsFeatures(), query, solution.cigar, true);
 
-      if (!strictCodonBoundaries) {
+      if (!options.strictCodonBoundaries) {
 	for (auto& c : aaAlignments)
-	  optimizeMisaligned(c, aligner.scorer().aminoAcidScorer());
+	  optimizeMisaligned(c, scorer.aminoAcidScorer());
       }
 
       std::ofstream aa;
-      if (!cdsAlignmentsFile.empty())
-	aa.open(cdsAlignmentsFile);
+      if (!options.cdsAlignmentsFile.empty())
+	aa.open(options.cdsAlignmentsFile);
 
       std::ofstream nt;
-      if (!cdsNtAlignmentsFile.empty())
-	nt.open(cdsNtAlignmentsFile);
+      if (!options.cdsNtAlignmentsFile.empty())
+	nt.open(options.cdsNtAlignmentsFile);
 
       int aaScore = 0;
 
@@ -350,7 +748,7 @@ void runAga(Aligner& aligner, const Genome& ref, const std::string& queriesFile,
 	if (nt.is_open())
 	  nt << a.ref.ntSequence << a.query.ntSequence;
 	auto aaStats = calcStats(a.ref.aaSequence, a.query.aaSequence,
-				 aligner.scorer().aminoAcidScorer(),
+				 scorer.aminoAcidScorer(),
 				 a.refFrameshiftCount() + a.queryFrameshifts);
 
 	aaScore += aaStats.score;
@@ -366,7 +764,7 @@ void runAga(Aligner& aligner, const Genome& ref, const std::string& queriesFile,
 	solution.cigar.align(alignedRef, alignedQuery);
 
 	concordance = calcConcordance(alignedRef, alignedQuery,
-				      aligner.scorer(), 0, true);
+				      scorer, 0, true);
       }
       
       std::cout << std::endl
@@ -376,22 +774,22 @@ void runAga(Aligner& aligner, const Genome& ref, const std::string& queriesFile,
 		<< "Alignment concordance: " << concordance << "%" << std::endl;
     }
 
-    if (!proteins.empty()) {
+    if (!options.proteins.empty()) {
       std::vector<CDSAlignment> aaAlignments
-	= getCDSAlignments(ref, proteins, query, solution.cigar, true);
+	= getCDSAlignments(ref, options.proteins, query, solution.cigar, true);
 
-      if (!strictCodonBoundaries) {
+      if (!options.strictCodonBoundaries) {
 	for (auto& c : aaAlignments)
-	  optimizeMisaligned(c, aligner.scorer().aminoAcidScorer());
+	  optimizeMisaligned(c, scorer.aminoAcidScorer());
       }
 
       std::ofstream aa;
-      if (!proteinAlignemntsFile.empty())
-	aa.open(proteinAlignemntsFile);
+      if (!options.proteinAlignmentsFile.empty())
+	aa.open(options.proteinAlignmentsFile);
 
       std::ofstream nt;
-      if (!proteinNtAlignemntsFile.empty())
-	nt.open(proteinNtAlignemntsFile);
+      if (!options.proteinNtAlignmentsFile.empty())
+	nt.open(options.proteinNtAlignmentsFile);
 
       std::cout << std::endl << "Protein Product alignments:" << std::endl;
       for (const auto& a : aaAlignments) {
@@ -401,7 +799,7 @@ void runAga(Aligner& aligner, const Genome& ref, const std::string& queriesFile,
 	  nt << a.ref.ntSequence << a.query.ntSequence;
 
 	auto aaStats = calcStats(a.ref.aaSequence, a.query.aaSequence,
-				 aligner.scorer().aminoAcidScorer(),
+				 scorer.aminoAcidScorer(),
 				 a.refFrameshiftCount() + a.queryFrameshifts);
 	if (aaStats.coverage > 0)
 	  std::cout << " AA " << a.ref.aaSequence.name()
@@ -540,11 +938,73 @@ int main(int argc, char **argv)
      "File containing seed alignment CIGAR",
      {"seed-alignment"});
 
+  args::ValueFlag<std::string> anchorsSeed
+    (generalGroup, "FILE",
+     "File containing anchors (1-based ref position, query position and length "
+     "per line), chained into a seed alignment",
+     {"seed-anchors"});
+
+  args::Flag autoSeed(generalGroup, "auto-seed",
+		      "Seed the alignment with minimizer and translated "
+		      "amino acid matches, without --seed-alignment",
+		      {"auto-seed"});
+
+  args::Flag splitAtSeed(generalGroup, "split-at-seed",
+			 "Split the global alignment at exact matches within "
+			 "the seed, and align the parts independently (in "
+			 "parallel with --threads)",
+			 {"split-at-seed"});
+
+  args::Flag adaptiveBand(generalGroup, "adaptive-band",
+			  "Choose the margin around the seed (and whether to "
+			  "use it at all) from the divergence of the query",
+			  {"adaptive-band"});
+
+  args::Flag refWindow(generalGroup, "window",
+		       "Align against the part of the reference around the "
+		       "seed only, with the CDS features cropped to it (not "
+		       "for a circular reference)",
+		       {"window"});
+
+  args::ValueFlag<int> twoPass
+    (generalGroup, "BAND",
+     "Global alignment in two passes: with nucleotide scores, and then with "
+     "all scores within BAND positions of that alignment (default=0: off)",
+     {"two-pass"}, 0);
+
+  args::Flag codonPass(generalGroup, "codon-pass",
+		       "With --two-pass, a first pass at codon resolution "
+		       "with all scores, instead of with nucleotide scores",
+		       {"codon-pass"});
+
   args::ValueFlag<int> maxLength
     (generalGroup, "LENGTH",
      "Max length to align, ~ sqrt(ref len * query len), or 0 for unlimited (default=0)",
      {"max-length"}, 0);
 
+  args::Flag linearSpace(generalGroup, "linear-space",
+			 "Global alignment using memory linear in the sequence "
+			 "lengths (slower)",
+			 {"linear-space"});
+
+  args::ValueFlag<int> threads
+    (generalGroup, "THREADS",
+     "Number of threads for a global alignment (default=1)",
+     {"threads"}, 1);
+
+  args::ValueFlag<int> xDrop
+    (generalGroup, "SCORE",
+     "Global alignment dropping cells that score more than SCORE below "
+     "the best cell of their column, or 0 to compute all cells "
+     "(default=0). This is a heuristic: a small SCORE may drop the "
+     "optimal alignment and give a worse one",
+     {"x-drop"}, 0);
+
+  args::ValueFlag<int> memoryLimit
+    (generalGroup, "MB",
+     "Memory limit for the alignment matrix, in MB (default=1000)",
+     {"memory-limit"}, 1000);
+
   args::Group aaOutputGroup(parser, "Amino acid alignments output",
 			    args::Group::Validators::DontCare);
   args::ValueFlag<std::string> cdsOutput
@@ -608,19 +1068,20 @@ int main(int argc, char **argv)
   }
   
   std::string genomeFile = args::get(genome);
-  std::string queriesFile = args::get(query);
   int ntWeight = args::get(ntWeightFlag);
   int aaWeight = args::get(aaWeightFlag);
 
+  RunOptions options;
+  options.queriesFile = args::get(query);
+
   Genome ref;
-  std::vector<CdsFeature> proteins;
 
   if (endsWith(genomeFile, ".fasta") && exists(file(genomeFile, ".cds")))
-    ref = readGenome(genomeFile, file(genomeFile, ".cds"), proteins);
+    ref = readGenome(genomeFile, file(genomeFile, ".cds"), options.proteins);
   else {
     GenbankRecord refGb = readGenomeGb(genomeFile);
     ref = getGenome(refGb);
-    proteins = getProteins(ref, refGb);
+    options.proteins = getProteins(ref, refGb);
   }
   
   std::cout << "Using CDS:" << std::endl;
@@ -674,10 +1135,8 @@ int main(int argc, char **argv)
   }
 #endif
 
-  ref.preprocess(ntWeight, aaWeight);
   GenomeScorer genomeScorer(ntScorer, aaScorer, ntWeight, aaWeight);
-
-  Cigar seed;
+  ref.preprocess(genomeScorer);
 
   std::string seedCigarFile = args::get(alignmentSeed);
   if (!seedCigarFile.empty()) {
@@ -688,23 +1147,88 @@ int main(int argc, char **argv)
     }
     std::string s;
     f >> s;
-    seed = Cigar::fromString(s);
+    options.seed = Cigar::fromString(s);
   }
 
-  int maxL = args::get(maxLength);
+  std::string anchorsFile = args::get(anchorsSeed);
+  if (!anchorsFile.empty() && !readAnchors(anchorsFile, options.seedAnchors)) {
+    std::cerr << "Error: --seed-anchors: could not read file" << std::endl;
+    return 1;
+  }
+
+  options.autoSeed = autoSeed;
+  options.adaptiveBand = adaptiveBand;
+  options.refWindow = refWindow;
+  options.codonPass = codonPass;
+  options.maxLength = args::get(maxLength);
+  options.strictCodonBoundaries = strictCodonBoundaries;
+
+  options.ntAlignmentFile = args::get(ntAlignment);
+  options.cdsAlignmentsFile = args::get(cdsOutput);
+  options.cdsNtAlignmentsFile = args::get(cdsNtOutput);
+  options.proteinAlignmentsFile = args::get(proteinOutput);
+  options.proteinNtAlignmentsFile = args::get(proteinNtOutput);
+
+  const unsigned long memoryLimitBytes
+    = std::max(1, args::get(memoryLimit)) * 1000UL * 1000;
+
+  /*
+   * Without amino acid scores, a nucleotide scorer, weighted like
+   * the GenomeScorer, gives the same alignment without the states and
+   * translations needed for codons.
+   */
+  const bool nucleotideOnly = aaWeight == 0 || ref.cdsFeatures().empty();
+
+  const int **ntWeightedMat
+    = ntScoreMatrix(ntWeight * args::get(ntMatchFlag),
+		    ntWeight * args::get(ntMismMatchFlag));
+  SimpleScorer<seq::NTSequence> ntOnlyScorer(ntWeightedMat,
+					     ntWeight * args::get(ntGapOpenFlag),
+					     ntWeight * args::get(ntGapExtendFlag),
+					     0, 0);
+  typedef SimpleScorer<seq::NTSequence> NtOnlyScorer;
+
+  if (nucleotideOnly)
+    std::cerr << "Using nucleotide scores only" << std::endl;
+
+  /* A nucleotide first pass only helps a global alignment with all scores */
+  options.twoPassBand = std::max(0, args::get(twoPass));
+  if (options.twoPassBand > 0 && (local || nucleotideOnly)) {
+    std::cerr << "Ignoring --two-pass: only for a global alignment "
+	      << "with amino acid scores" << std::endl;
+    options.twoPassBand = 0;
+  }
+
+  options.splitAtSeed = splitAtSeed;
 
   if (local) {
-    LocalAligner<GenomeScorer, Genome, NTSequence6AA, 3> aligner(genomeScorer);
-    runAga(aligner, ref, queriesFile, seed, maxL, strictCodonBoundaries,
-	   proteins, args::get(ntAlignment),
-	   args::get(cdsOutput), args::get(proteinOutput),
-	   args::get(cdsNtOutput), args::get(proteinNtOutput));
+    if (nucleotideOnly) {
+      LocalAligner<NtOnlyScorer, seq::NTSequence, seq::NTSequence,
+		   NtOnlyScorer::SideN> aligner(ntOnlyScorer);
+      aligner.setMemoryLimit(memoryLimitBytes);
+      runAga<seq::NTSequence>(aligner, genomeScorer, ref, options);
+    } else {
+      LocalAligner<GenomeScorer, Genome, NTSequence6AA, 3> aligner(genomeScorer);
+      aligner.setMemoryLimit(memoryLimitBytes);
+      runAga<NTSequence6AA>(aligner, genomeScorer, ref, options);
+    }
   } else {
-    GlobalAligner<GenomeScorer, Genome, NTSequence6AA, 3> aligner(genomeScorer);
-    runAga(aligner, ref, queriesFile, seed, maxL, strictCodonBoundaries,
-	   proteins, args::get(ntAlignment),
-	   args::get(cdsOutput), args::get(proteinOutput),
-	   args::get(cdsNtOutput), args::get(proteinNtOutput));
+    if (nucleotideOnly) {
+      GlobalAligner<NtOnlyScorer, seq::NTSequence, seq::NTSequence,
+		    NtOnlyScorer::SideN> aligner(ntOnlyScorer);
+      aligner.setLinearSpace(linearSpace);
+      aligner.setThreads(args::get(threads));
+      aligner.setXDrop(args::get(xDrop) * ref.scoreFactor());
+      aligner.setMemoryLimit(memoryLimitBytes);
+      runAga<seq::NTSequence>(aligner, genomeScorer, ref, options);
+    } else {
+      GlobalAligner<GenomeScorer, Genome, NTSequence6AA, 3> aligner(genomeScorer);
+      aligner.setLinearSpace(linearSpace);
+      aligner.setThreads(args::get(threads));
+      aligner.setXDrop(args::get(xDrop) * ref.scoreFactor());
+      aligner.setMemoryLimit(memoryLimitBytes);
+      runAga<NTSequence6AA>(aligner, genomeScorer, ref, options);
+    }
   }
 
   return 0;
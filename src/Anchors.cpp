@@ -0,0 +1,288 @@
+/*
+ * Copyright Emweb BVBA, 3020 Herent, Belgium
+ *
+ * See LICENSE.txt for terms of use.
+ */
+
+#include "Anchors.h"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+namespace {
+
+/*
+ * Chaining scores: per anchored position, per position skipped in
+ * the reference or the query, and per position of diagonal shift
+ * between consecutive anchors. The shift cost is higher than the
+ * match score, so that a chain never gains from reusing positions.
+ */
+const int MatchScore = 32;
+const int SkipCost = 1;
+const int ShiftCost = MatchScore + SkipCost;
+
+/*
+ * A Fenwick tree of the maximum score (and its anchor) of each
+ * prefix of keys.
+ */
+class MaxTree
+{
+public:
+  struct Value {
+    int score, index;
+  };
+
+  MaxTree(int size)
+    : tree_(size + 1, Value{ 0, -1 })
+  { }
+
+  void update(int key, int score, int index) {
+    for (unsigned i = key + 1; i < tree_.size(); i += i & -i)
+      if (tree_[i].index == -1 || tree_[i].score < score)
+	tree_[i] = Value{ score, index };
+  }
+
+  /* The maximum over keys [0, end) */
+  Value prefixMax(int end) const {
+    Value result{ 0, -1 };
+    for (int i = end; i > 0; i -= i & -i)
+      if (result.index == -1
+	  || (tree_[i].index != -1 && tree_[i].score > result.score))
+	result = tree_[i];
+    return result;
+  }
+
+private:
+  std::vector<Value> tree_;
+};
+
+void addItem(Cigar& cigar, CigarItem::Op op, int length)
+{
+  if (length <= 0)
+    return;
+
+  if (!cigar.empty() && cigar.back().op() == op)
+    cigar.back().add(length);
+  else
+    cigar.push_back(CigarItem(op, length));
+}
+
+}
+
+std::vector<Anchor> mergeAnchors(std::vector<Anchor> anchors)
+{
+  std::sort(anchors.begin(), anchors.end(),
+	    [](const Anchor& a, const Anchor& b) {
+	      const int da = a.refStart - a.queryStart;
+	      const int db = b.refStart - b.queryStart;
+	      if (da != db)
+		return da < db;
+	      else
+		return a.queryStart < b.queryStart;
+	    });
+
+  std::vector<Anchor> result;
+  for (const auto& a : anchors) {
+    if (!result.empty()) {
+      Anchor& last = result.back();
+      if (last.refStart - last.queryStart == a.refStart - a.queryStart
+	  && a.queryStart <= last.queryEnd()) {
+	last.length = std::max(last.length, a.queryEnd() - last.queryStart);
+	continue;
+      }
+    }
+
+    result.push_back(a);
+  }
+
+  return result;
+}
+
+std::vector<Anchor> chainAnchors(std::vector<Anchor> anchors)
+{
+  /*
+   * The best chain ending in anchor i scores:
+   *
+   *   f(i) = MatchScore * length(i) + max(0, max_j (f(j) - cost(j, i)))
+   *
+   *   cost(j, i) = SkipCost * (dr + dq) + ShiftCost * |dr - dq|
+   *
+   * with dr = r(i) - rEnd(j) and dq = q(i) - qEnd(j), over the
+   * anchors j that end before i starts.
+   *
+   * The sign of dr - dq is the order of the diagonals of j and i, and
+   * for each sign the cost is separable in the reference and the
+   * query. Thus, sweeping the anchors over the reference, the best j
+   * is found in two maximum trees over the diagonal of the anchors
+   * that ended, in O(n log n):
+   *
+   *  - for the diagonals below i (dq > dr), a j that ended in the
+   *    reference also ended in the query;
+   *  - for the diagonals at or above i (dr >= dq), a j may still
+   *    overlap i in the query (dq < 0), which then costs more than
+   *    the positions it matched twice.
+   */
+  const int n = anchors.size();
+
+  std::vector<int> diagonals;
+  for (const auto& a : anchors)
+    diagonals.push_back(a.refStart - a.queryStart);
+  std::sort(diagonals.begin(), diagonals.end());
+  diagonals.erase(std::unique(diagonals.begin(), diagonals.end()),
+		  diagonals.end());
+
+  auto diagonalKey = [&diagonals](const Anchor& a) {
+    return std::lower_bound(diagonals.begin(), diagonals.end(),
+			    a.refStart - a.queryStart) - diagonals.begin();
+  };
+
+  /*
+   * Events: the start (query) and end (insert) of each anchor, with
+   * ends before starts at the same position, so that adjacent anchors
+   * chain.
+   */
+  struct Event {
+    int pos;
+    bool start;
+    int anchor;
+  };
+
+  std::vector<Event> events;
+  events.reserve(2 * n);
+  for (int i = 0; i < n; ++i) {
+    events.push_back(Event{ anchors[i].refStart, true, i });
+    events.push_back(Event{ anchors[i].refEnd(), false, i });
+  }
+
+  std::sort(events.begin(), events.end(),
+	    [](const Event& a, const Event& b) {
+	      if (a.pos != b.pos)
+		return a.pos < b.pos;
+	      else
+		return !a.start && b.start;
+	    });
+
+  const int keys = diagonals.size();
+  MaxTree above(keys);  // diagonals <= i (dr >= dq), by diagonal
+  MaxTree below(keys);  // diagonals > i (dq > dr), by reverse diagonal
+  std::vector<int> score(n), previous(n, -1);
+  int best = -1;
+
+  for (const auto& e : events) {
+    const Anchor& a = anchors[e.anchor];
+    const int key = diagonalKey(a);
+
+    if (e.start) {
+      const int i = e.anchor;
+      score[i] = MatchScore * a.length;
+
+      int chained = 0;
+
+      MaxTree::Value v = above.prefixMax(key + 1);
+      if (v.index != -1) {
+	int s = v.score - (SkipCost + ShiftCost) * a.refStart
+	  - (SkipCost - ShiftCost) * a.queryStart;
+	if (s > chained) {
+	  chained = s;
+	  previous[i] = v.index;
+	}
+      }
+
+      v = below.prefixMax(keys - key - 1);
+      if (v.index != -1) {
+	int s = v.score - (SkipCost - ShiftCost) * a.refStart
+	  - (SkipCost + ShiftCost) * a.queryStart;
+	if (s > chained) {
+	  chained = s;
+	  previous[i] = v.index;
+	}
+      }
+
+      score[i] += chained;
+
+      if (best == -1 || score[i] > score[best])
+	best = i;
+    } else {
+      const int s = score[e.anchor];
+      above.update(key, s + (SkipCost + ShiftCost) * a.refEnd()
+		   + (SkipCost - ShiftCost) * a.queryEnd(), e.anchor);
+      below.update(keys - key - 1, s + (SkipCost - ShiftCost) * a.refEnd()
+		   + (SkipCost + ShiftCost) * a.queryEnd(), e.anchor);
+    }
+  }
+
+  std::vector<Anchor> result;
+  for (int i = best; i != -1; i = previous[i])
+    result.push_back(anchors[i]);
+
+  std::reverse(result.begin(), result.end());
+
+  return result;
+}
+
+Cigar seedCigar(const std::vector<Anchor>& chain, int refSize, int querySize)
+{
+  Cigar result;
+
+  int refI = 0, queryI = 0;
+  bool first = true;
+
+  for (const auto& a : chain) {
+    const int overlap = std::max(0, std::max(refI - a.refStart,
+					     queryI - a.queryStart));
+    const int length = std::min(a.length - overlap,
+				std::min(refSize - a.refStart - overlap,
+					 querySize - a.queryStart - overlap));
+    if (length <= 0)
+      continue;
+
+    const int dr = a.refStart + overlap - refI;
+    const int dq = a.queryStart + overlap - queryI;
+
+    if (!first && dr == dq)
+      addItem(result, CigarItem::Match, dr);
+    else {
+      addItem(result, CigarItem::RefSkipped, dr);
+      addItem(result, CigarItem::QuerySkipped, dq);
+    }
+
+    addItem(result, CigarItem::Match, length);
+
+    refI += dr + length;
+    queryI += dq + length;
+    first = false;
+  }
+
+  if (first)
+    return result;
+
+  addItem(result, CigarItem::RefSkipped, refSize - refI);
+  addItem(result, CigarItem::QuerySkipped, querySize - queryI);
+
+  return result;
+}
+
+bool readAnchors(const std::string& file, std::vector<Anchor>& anchors)
+{
+  std::ifstream f(file);
+  if (!f)
+    return false;
+
+  std::string line;
+  while (std::getline(f, line)) {
+    if (line.find_first_not_of(" \t\r") == std::string::npos)
+      continue;
+
+    std::istringstream s(line);
+    int refPos, queryPos, length;
+    std::string rest;
+    if (!(s >> refPos >> queryPos >> length) || (s >> rest)
+	|| refPos < 1 || queryPos < 1 || length < 1)
+      return false;
+
+    anchors.push_back(Anchor(refPos - 1, queryPos - 1, length));
+  }
+
+  return true;
+}
@@ -0,0 +1,74 @@
+// This may look like C code, but it's really -*- C++ -*-
+/*
+ * Copyright Emweb BVBA, 3020 Herent, Belgium
+ *
+ * See LICENSE.txt for terms of use.
+ */
+#ifndef ANCHORS_H_
+#define ANCHORS_H_
+
+#include <string>
+#include <vector>
+
+#include "Cigar.h"
+
+/*
+ * A match of length positions between the reference from refStart
+ * and the query from queryStart.
+ */
+struct Anchor
+{
+  Anchor()
+    : refStart(0), queryStart(0), length(0)
+  { }
+
+  Anchor(int aRefStart, int aQueryStart, int aLength)
+    : refStart(aRefStart), queryStart(aQueryStart), length(aLength)
+  { }
+
+  int refEnd() const { return refStart + length; }
+  int queryEnd() const { return queryStart + length; }
+
+  int refStart, queryStart, length;
+};
+
+/*
+ * Merges the anchors that overlap or touch on the same diagonal into
+ * a single anchor. Returns the anchors ordered by diagonal.
+ */
+extern std::vector<Anchor> mergeAnchors(std::vector<Anchor> anchors);
+
+/*
+ * Selects the best chain of colinear anchors: anchors that are
+ * ordered in both the reference and the query. A chain scores its
+ * anchored positions, minus the positions skipped between consecutive
+ * anchors and (more heavily) the shift in diagonal between them, so
+ * that an anchor that is inconsistent with its neighbours is left
+ * out.
+ *
+ * Runs in O(n log n). Returns the chain, ordered.
+ */
+extern std::vector<Anchor> chainAnchors(std::vector<Anchor> anchors);
+
+/*
+ * Converts a chain of anchors into a seed for getSearchRange(): the
+ * anchors become Match items, and the positions between them are
+ * RefSkipped and QuerySkipped, except when they continue the diagonal
+ * of the previous anchor (as mismatches), in which case they are
+ * also Match items. Overlaps between consecutive anchors are removed
+ * from the later anchor.
+ *
+ * Returns an empty cigar for an empty chain.
+ */
+extern Cigar seedCigar(const std::vector<Anchor>& chain,
+		       int refSize, int querySize);
+
+/*
+ * Reads anchors from a file: a reference position, a query position
+ * (1-based) and a length per line. Blank lines are skipped. Returns
+ * false if the file cannot be read, or if a line is not three
+ * positive numbers.
+ */
+extern bool readAnchors(const std::string& file, std::vector<Anchor>& anchors);
+
+#endif // ANCHORS_H_
@@ -0,0 +1,364 @@
+// This may look like C code, but it's really -*- C++ -*-
+/*
+ * Copyright Emweb BVBA, 3020 Herent, Belgium
+ *
+ * See LICENSE.txt for terms of use.
+ */
+#ifndef BATCH_ALIGNER_H_
+#define BATCH_ALIGNER_H_
+
+#include <limits>
+#include <algorithm>
+#include <numeric>
+
+#include "Cigar.h"
+#include "SearchRange.h"
+#include "ColumnKernel.h"
+#include "EndGaps.h"
+#include "StripeSize.h"
+
+/*
+ * Global alignment of many queries against a single reference.
+ *
+ * Queries are aligned in batches of Lanes queries of similar length,
+ * in lockstep: every reference column is prepared once and evaluated
+ * for all queries of a batch with a single kernel call, with one query
+ * per vector lane. Each query may have its own search range. The
+ * results are identical to those of GlobalAligner without X-drop, as
+ * long as the alignment does not touch the border of the search range
+ * (which GlobalAligner widens).
+ *
+ * This does not make aligning faster: the costs are still set through
+ * the scorer, per cell and per lane, and the columns of a batch are
+ * Lanes times larger, so that they no longer fit in the cache. A batch
+ * of 16 queries of 6 kb takes about a quarter longer than aligning them
+ * one by one with GlobalAligner.
+ */
+template <class Scorer, class Reference, class Query, int SideN,
+	  int Lanes = 8>
+class BatchAligner
+{
+  static_assert(SideN > 0, "BatchAligner requires SideN > 0");
+
+public:
+  BatchAligner(const Scorer& scorer)
+    : scorer_(scorer),
+      memoryLimit_(1000UL*1000*1000)
+  { }
+
+  struct Solution {
+    Solution()
+      : score(0) { }
+    int score;
+    Cigar cigar;
+  };
+
+  /*
+   * Aligns each of the queries against ref, returning the solutions
+   * in the order of the queries. The search range of queries[q] is
+   * ranges[q], or the full matrix if ranges is empty.
+   */
+  std::vector<Solution> align(const Reference& ref,
+			      const std::vector<Query>& queries,
+			      const std::vector<SearchRange>& ranges
+			      = std::vector<SearchRange>());
+
+  Scorer& scorer() { return scorer_; }
+
+  /*
+   * Limits the memory used for the matrix of a batch (in bytes,
+   * default 1 GB), see GlobalAligner.
+   */
+  void setMemoryLimit(unsigned long bytes) { memoryLimit_ = bytes; }
+  unsigned long memoryLimit() const { return memoryLimit_; }
+
+private:
+  Scorer scorer_;
+  unsigned long memoryLimit_;
+
+  static const int INVALID_SCORE;
+
+  typedef ColumnKernel<SideN, Lanes> Kernel;
+  typedef typename Kernel::TraceCell TraceCell;
+
+  /*
+   * A batch of queries with their search ranges, with rows up to the
+   * longest query. Unused lanes repeat the last query.
+   */
+  struct Batch {
+    const Query *queries[Lanes];
+    const SearchRange *ranges[Lanes];
+    int count;
+    int rows;
+
+    int index(int hj, int l) const { return hj * Lanes + l; }
+  };
+
+  /*
+   * Scores of a column: a plane per state, with rows * Lanes cells,
+   * and invalid scores outside the computed rows [start[l], end[l])
+   * of each lane.
+   */
+  struct Column {
+    Column(int cells)
+      : scores(cells, INVALID_SCORE)
+    {
+      std::fill(start, start + Lanes, 0);
+      std::fill(end, end + Lanes, 0);
+    }
+
+    void resetRange(int l, int aStart, int anEnd) {
+      invalidate(l, start[l], std::min(end[l], aStart));
+      invalidate(l, std::max(start[l], anEnd), end[l]);
+      start[l] = aStart;
+      end[l] = anEnd;
+    }
+
+    void invalidate(int l, int from, int to) {
+      const int plane = scores.size() / Kernel::StateCount;
+      for (int s = 0; s < Kernel::StateCount; ++s)
+	for (int hj = from; hj < to; ++hj)
+	  scores[s * plane + hj * Lanes + l] = INVALID_SCORE;
+    }
+
+    std::vector<int> scores;
+    int start[Lanes], end[Lanes];
+  };
+
+  typedef std::vector<std::vector<TraceCell>> Trace;
+
+  struct Stripe {
+    Stripe(unsigned aStart, unsigned aN, const Column& aBoundary)
+      : start(aStart), n(aN), boundary(aBoundary)
+    { }
+
+    unsigned start, n;
+    Column boundary;
+  };
+
+  void alignBatch(const Reference& ref, const Batch& batch,
+		  Solution *results[Lanes]);
+  void computeStripe(const Reference& ref, const Batch& batch,
+		     const Stripe& stripe, Column& column, Trace& trace,
+		     Kernel& kernel);
+};
+
+template <class Scorer, class Reference, class Query, int SideN, int Lanes>
+const int BatchAligner<Scorer, Reference, Query, SideN, Lanes>::INVALID_SCORE
+  = Kernel::InvalidScore;
+
+template <class Scorer, class Reference, class Query, int SideN, int Lanes>
+std::vector<typename BatchAligner<Scorer, Reference, Query, SideN,
+				  Lanes>::Solution>
+BatchAligner<Scorer, Reference, Query, SideN, Lanes>
+::align(const Reference& ref, const std::vector<Query>& queries,
+	const std::vector<SearchRange>& ranges)
+{
+  std::vector<Solution> results(queries.size());
+
+  std::vector<SearchRange> fullRanges;
+  if (ranges.empty())
+    for (const auto& q : queries)
+      fullRanges.push_back(SearchRange(ref.size() + 1, q.size() + 1));
+
+  const std::vector<SearchRange>& queryRanges
+    = ranges.empty() ? fullRanges : ranges;
+
+  /* Batch queries of similar length, to waste few cells on padding */
+  std::vector<unsigned> order(queries.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(),
+		   [&queries](unsigned a, unsigned b) {
+		     return queries[a].size() < queries[b].size();
+		   });
+
+  for (unsigned b = 0; b < order.size(); b += Lanes) {
+    Batch batch;
+    Solution *batchResults[Lanes];
+
+    batch.count = std::min((unsigned)Lanes, (unsigned)order.size() - b);
+    batch.rows = 0;
+    for (int l = 0; l < Lanes; ++l) {
+      unsigned q = order[b + std::min(l, batch.count - 1)];
+      batch.queries[l] = &queries[q];
+      batch.ranges[l] = &queryRanges[q];
+      batchResults[l] = &results[q];
+      batch.rows = std::max(batch.rows, (int)queries[q].size() + 1);
+    }
+
+    alignBatch(ref, batch, batchResults);
+  }
+
+  return results;
+}
+
+template <class Scorer, class Reference, class Query, int SideN, int Lanes>
+void BatchAligner<Scorer, Reference, Query, SideN, Lanes>
+::alignBatch(const Reference& ref, const Batch& batch,
+	     Solution *results[Lanes])
+{
+  const int rows = batch.rows;
+  const int plane = rows * Lanes;
+
+  Column column(Kernel::StateCount * plane);
+  int *D = &column.scores[Kernel::StateD * plane];
+  int *M = &column.scores[Kernel::StateM * plane];
+
+  for (int l = 0; l < Lanes; ++l) {
+    const Query& query = *batch.queries[l];
+    const SearchRange& sr = *batch.ranges[l];
+
+    column.start[l] = sr.startRow(0);
+    column.end[l] = std::max(column.start[l], sr.endRow(0));
+
+    int score = 0;
+    for (int hj = 1; hj < column.end[l]; ++hj) {
+      int j = hj - 1;
+      if (j == 0)
+	score += scorer_.scoreOpenRefGap(ref, query, -1, 0);
+      else
+	score += scorer_.scoreExtendRefGap(ref, query, -1, j, j);
+
+      if (hj >= column.start[l])
+	D[batch.index(hj, l)] = M[batch.index(hj, l)] = score;
+    }
+
+    D[batch.index(0, l)] = M[batch.index(0, l)]
+      = scorer_.scoreOpenQueryGap(ref, query, -1, -1);
+  }
+
+  /*
+   * As in GlobalAligner, the matrix is computed in stripes within the
+   * memory limit, and earlier stripes are recomputed from their
+   * boundary column for the traceback, once for all lanes.
+   */
+  const unsigned long columnBytes = column.scores.size() * sizeof(int);
+  const unsigned long kernelBytes
+    = plane * ((6 + 2 * SideN) * sizeof(int) + sizeof(TraceCell));
+
+  const unsigned N
+    = chooseStripeColumns(memoryLimit_, ref.size(),
+			  plane * sizeof(TraceCell)
+			  + sizeof(std::vector<TraceCell>),
+			  columnBytes + sizeof(Stripe),
+			  3 * columnBytes + kernelBytes);
+
+  Trace trace(N, std::vector<TraceCell>(plane));
+  std::vector<Stripe> stripes;
+  Kernel kernel(rows);
+
+  unsigned stripeI = 0;
+  do {
+    unsigned n = std::min((unsigned)(ref.size() - stripeI), N);
+    stripes.push_back(Stripe(stripeI, n, column));
+    computeStripe(ref, batch, stripes.back(), column, trace, kernel);
+    stripeI += n;
+  } while (stripeI < ref.size());
+
+  int hi[Lanes], hj[Lanes], state[Lanes];
+  Cigar rCigar[Lanes];
+
+  for (int l = 0; l < batch.count; ++l) {
+    hi[l] = ref.size();
+    hj[l] = batch.queries[l]->size();
+    state[l] = Kernel::StateD;
+    results[l]->score
+      = column.scores[Kernel::StateD * plane + batch.index(hj[l], l)];
+  }
+
+  /* Trace back all lanes through each stripe, from the last stripe */
+  for (int s = stripes.size() - 1; s >= 0; --s) {
+    if (s != (int)stripes.size() - 1)
+      computeStripe(ref, batch, stripes[s], column, trace, kernel);
+
+    const int start = stripes[s].start;
+
+    for (int l = 0; l < batch.count; ++l) {
+      while (hi[l] > start) {
+	CigarItem::Op op;
+
+	if (hj[l] == 0) {
+	  op = CigarItem::QueryGap;
+	  --hi[l];
+	} else
+	  op = Kernel::traceBack(trace[hi[l] - 1 - start]
+				 [batch.index(hj[l], l)],
+				 state[l], hi[l], hj[l]);
+
+	if (rCigar[l].size() > 0 && rCigar[l].back().op() == op)
+	  rCigar[l].back().add();
+	else
+	  rCigar[l].push_back(CigarItem(op));
+      }
+    }
+  }
+
+  for (int l = 0; l < batch.count; ++l) {
+    if (hj[l] > 0) {
+      if (rCigar[l].size() > 0 && rCigar[l].back().op() == CigarItem::RefGap)
+	rCigar[l].back().add(hj[l]);
+      else
+	rCigar[l].push_back(CigarItem(CigarItem::RefGap, hj[l]));
+    }
+
+    Cigar& cigar = results[l]->cigar;
+    cigar.insert(cigar.end(), rCigar[l].rbegin(), rCigar[l].rend());
+    convertEndGaps(scorer_, cigar);
+  }
+}
+
+template <class Scorer, class Reference, class Query, int SideN, int Lanes>
+void BatchAligner<Scorer, Reference, Query, SideN, Lanes>
+::computeStripe(const Reference& ref, const Batch& batch,
+		const Stripe& stripe, Column& column, Trace& trace,
+		Kernel& kernel)
+{
+  const int plane = batch.rows * Lanes;
+
+  Column prev = stripe.boundary;
+  Column cur(prev.scores.size());
+
+  for (unsigned i = stripe.start; i < stripe.start + stripe.n; ++i) {
+    /*
+     * The kernel computes the union of the rows of all lanes, after
+     * which the rows outside the range of a lane are invalidated.
+     */
+    int from = batch.rows, to = 1;
+
+    for (int l = 0; l < Lanes; ++l) {
+      const SearchRange& sr = *batch.ranges[l];
+      const int start = std::max(prev.start[l], sr.startRow(i + 1));
+      const int end = std::max(start, sr.endRow(i + 1));
+
+      cur.resetRange(l, start, end);
+
+      if (start == 0) {
+	const int c = batch.index(0, l);
+	cur.scores[Kernel::StateD * plane + c]
+	  = cur.scores[Kernel::StateM * plane + c]
+	  = prev.scores[Kernel::StateD * plane + c]
+	  + scorer_.scoreExtendQueryGap(ref, *batch.queries[l], i, -1, i);
+      }
+
+      from = std::min(from, std::max(1, start));
+      to = std::max(to, end);
+    }
+
+    if (from < to) {
+      kernel.setCosts(scorer_, ref, batch.queries, i, from, to);
+      kernel.run(from, to, prev.scores.data(), cur.scores.data(),
+		 trace[i - stripe.start].data() + from * Lanes);
+
+      for (int l = 0; l < Lanes; ++l) {
+	cur.invalidate(l, from, std::min(to, cur.start[l]));
+	cur.invalidate(l, std::max(from, cur.end[l]), to);
+      }
+    }
+
+    std::swap(prev, cur);
+  }
+
+  std::swap(column, prev);
+}
+
+#endif // BATCH_ALIGNER_H_
@@ -691,6 +691,42 @@ std::pair<Cigar, Cigar> Cigar::splitQuery(int queryPos) const
 
 }
 
+Cigar Cigar::cropRef(int start, int end) const
+{
+  Cigar result;
+
+  auto add = [&result](CigarItem::Op op, int length) {
+    if (length == 0)
+      return;
+    if (!result.empty() && result.back().op() == op)
+      result.back().add(length);
+    else
+      result.push_back(CigarItem(op, length));
+  };
+
+  int refI = 0;
+  for (const auto& item : *this) {
+    const int length = item.length();
+    switch (item.op()) {
+    case CigarItem::Match:
+    case CigarItem::QueryGap:
+    case CigarItem::RefSkipped: {
+      const int inside = std::max(0, std::min(refI + length, end)
+				  - std::max(refI, start));
+      if (item.op() == CigarItem::Match)
+	add(CigarItem::QuerySkipped, length - inside);
+      add(item.op(), inside);
+      refI += length;
+      break;
+    }
+    default:
+      add(item.op(), length);
+    }
+  }
+
+  return result;
+}
+
 std::string Cigar::str() const
 {
   std::stringstream ss;
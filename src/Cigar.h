@@ -162,6 +162,14 @@ struct Cigar : public std::vector<CigarItem>
 
   std::pair<Cigar, Cigar> splitQuery(int queryPos) const;
 
+  /*
+   * The alignment within the reference positions [start, end), in the
+   * coordinates of that window: the reference positions outside it are
+   * removed, and the query positions they were matched with become
+   * skipped.
+   */
+  Cigar cropRef(int start, int end) const;
+
   void wrapAround(int pos);
   void unwrap();
   
@@ -0,0 +1,261 @@
+/*
+ * Copyright Emweb BVBA, 3020 Herent, Belgium
+ *
+ * See LICENSE.txt for terms of use.
+ */
+
+#include "CodonAligner.h"
+
+#include <algorithm>
+#include <limits>
+
+const int CodonAligner::INVALID_SCORE = std::numeric_limits<int>::min() / 2;
+
+namespace {
+
+void addItem(Cigar& cigar, CigarItem::Op op, int length)
+{
+  if (length == 0)
+    return;
+
+  if (!cigar.empty() && cigar.back().op() == op)
+    cigar.back().add(length);
+  else
+    cigar.push_back(CigarItem(op, length));
+}
+
+}
+
+CodonAligner::CodonAligner(const GenomeScorer& scorer)
+  : scorer_(scorer)
+{ }
+
+int CodonAligner::scoreMatch(const Genome& ref, const NTSequence6AA& query,
+			     int refI, int queryI) const
+{
+  const int **ntMatrix = scorer_.nucleotideScorer().weightMatrix();
+  const int **aaMatrix = scorer_.aminoAcidScorer().weightMatrix();
+
+  int result = 0;
+  for (int k = 0; k < 3; ++k) {
+    const int i = refI + k, j = queryI + k;
+    const GenomePosition& pos = ref.position(i);
+
+    result += ntMatrix[ref[i].intRep()][query[j].intRep()] * pos.ntWeight;
+
+    int aaResult = 0;
+    for (const auto& c : ref.codons(i))
+      aaResult += aaMatrix[c.aa][query.aaRep(j, c.reverseComplement)];
+    result += aaResult * pos.aaWeight;
+  }
+
+  return result;
+}
+
+Cigar CodonAligner::align(const Genome& ref, const NTSequence6AA& query,
+			  const SearchRange& sr) const
+{
+  const int codons = ref.size() / 3;
+  const int rows = query.size() + 1;
+
+  Cigar result;
+  if (codons == 0) {
+    addItem(result, CigarItem::QueryGap, ref.size());
+    addItem(result, CigarItem::RefGap, query.size());
+    return result;
+  }
+
+  const bool refStartFree = !scorer_.scoreRefStartGap();
+  const bool refEndFree = !scorer_.scoreRefEndGap();
+  const bool queryStartFree = !scorer_.scoreQueryStartGap();
+  const bool queryEndFree = !scorer_.scoreQueryEndGap();
+
+  const int **ntMatrix = scorer_.nucleotideScorer().weightMatrix();
+
+  /*
+   * H, E (ending with a gap in the reference) and F (ending with a
+   * gap in the query) of the current and previous column
+   */
+  std::vector<int> H[2], E[2], F[2];
+  int startRow[2] = { 0, 0 }, endRow[2] = { 0, 0 };
+  for (int c = 0; c < 2; ++c) {
+    H[c].resize(rows, INVALID_SCORE);
+    E[c].resize(rows, INVALID_SCORE);
+    F[c].resize(rows, INVALID_SCORE);
+  }
+
+  std::vector<std::vector<unsigned char>> trace(codons + 1);
+  std::vector<int> traceStart(codons + 1);
+
+  int bestScore = INVALID_SCORE, bestA = -1, bestJ = -1;
+
+  auto consider = [&](int score, int a, int j) {
+    if (score > bestScore) {
+      bestScore = score;
+      bestA = a;
+      bestJ = j;
+    }
+  };
+
+  int start = 0;
+  for (int a = 0; a <= codons; ++a) {
+    const int cur = a % 2, prev = 1 - cur;
+
+    for (int j = startRow[cur]; j < endRow[cur]; ++j)
+      H[cur][j] = E[cur][j] = F[cur][j] = INVALID_SCORE;
+
+    start = std::max(start, sr.startRow(3 * a));
+    const int end = std::min(rows, sr.endRow(3 * a));
+    startRow[cur] = start;
+    endRow[cur] = std::max(start, end);
+
+    traceStart[a] = start;
+    trace[a].resize(endRow[cur] - start);
+
+    /* Costs of a gap in the reference after this codon boundary */
+    const GapCosts& rg = ref.gapCosts(std::max(0, 3 * a - 1));
+    const int refGapOpen = rg.openRef + rg.extendRef[1] + rg.extendRef[2];
+    const int refGapExtend
+      = rg.extendRef[0] + rg.extendRef[1] + rg.extendRef[2];
+    const int refShift[2] = { rg.openRef, rg.openRef + rg.extendRef[1] };
+
+    /* Costs of a gap in the query against the previous codon */
+    int queryGapOpen = 0, queryGapExtend = 0;
+    int queryShift[2] = { 0, 0 };
+    if (a > 0) {
+      const int i = 3 * (a - 1);
+      queryGapOpen = ref.gapCosts(i).openQuery
+	+ ref.gapCosts(i + 1).extendQuery[1]
+	+ ref.gapCosts(i + 2).extendQuery[2];
+      queryGapExtend = ref.gapCosts(i).extendQuery[0]
+	+ ref.gapCosts(i + 1).extendQuery[1]
+	+ ref.gapCosts(i + 2).extendQuery[2];
+
+      /* k nucleotides against the start of the codon, and a gap */
+      queryShift[0] = ref.gapCosts(i + 1).openQuery
+	+ ref.gapCosts(i + 2).extendQuery[1];
+      queryShift[1] = ref.gapCosts(i + 2).openQuery;
+    }
+
+    for (int j = start; j < endRow[cur]; ++j) {
+      unsigned char t = 0;
+
+      int e = INVALID_SCORE;
+      if (j >= 3 && H[cur][j - 3] != INVALID_SCORE)
+	e = H[cur][j - 3] + refGapOpen;
+      if (j >= 3 && E[cur][j - 3] != INVALID_SCORE
+	  && E[cur][j - 3] + refGapExtend > e) {
+	e = E[cur][j - 3] + refGapExtend;
+	t |= RefGapExtend;
+      }
+
+      int f = INVALID_SCORE;
+      if (a > 0 && H[prev][j] != INVALID_SCORE)
+	f = H[prev][j] + queryGapOpen;
+      if (a > 0 && F[prev][j] != INVALID_SCORE
+	  && F[prev][j] + queryGapExtend > f) {
+	f = F[prev][j] + queryGapExtend;
+	t |= QueryGapExtend;
+      }
+
+      int h = INVALID_SCORE, from = FromStart;
+
+      auto option = [&](int score, int o) {
+	if (score > h) {
+	  h = score;
+	  from = o;
+	}
+      };
+
+      if ((a == 0 && (j == 0 || refStartFree)) || (j == 0 && queryStartFree))
+	option(0, FromStart);
+
+      if (a > 0 && j >= 3 && H[prev][j - 3] != INVALID_SCORE)
+	option(H[prev][j - 3] + scoreMatch(ref, query, 3 * (a - 1), j - 3),
+	       FromMatch);
+
+      if (e != INVALID_SCORE)
+	option(e, FromRefGap);
+      if (f != INVALID_SCORE)
+	option(f, FromQueryGap);
+
+      for (int k = 1; k < 3; ++k) {
+	if (j >= k && H[cur][j - k] != INVALID_SCORE)
+	  option(H[cur][j - k] + refShift[k - 1], FromRefShift + k - 1);
+
+	if (a > 0 && j >= k && H[prev][j - k] != INVALID_SCORE) {
+	  const int i = 3 * (a - 1);
+	  int score = H[prev][j - k] + queryShift[k - 1];
+	  for (int l = 0; l < k; ++l)
+	    score += ref.ntWeight(i + l)
+	      * ntMatrix[ref[i + l].intRep()][query[j - k + l].intRep()];
+	  option(score, FromQueryShift + k - 1);
+	}
+      }
+
+      H[cur][j] = h;
+      E[cur][j] = e;
+      F[cur][j] = f;
+      trace[a][j - start] = t | from;
+
+      if (h != INVALID_SCORE
+	  && ((a == codons && (j == rows - 1 || refEndFree))
+	      || (j == rows - 1 && queryEndFree)))
+	consider(h, a, j);
+    }
+  }
+
+  if (bestA < 0)
+    return result;
+
+  /* The alignment is built backwards, and reversed at the end */
+  addItem(result, CigarItem::QueryGap,
+	  ref.size() - 3 * codons + 3 * (codons - bestA));
+  addItem(result, CigarItem::RefGap, rows - 1 - bestJ);
+
+  enum { StateH, StateE, StateF } state = StateH;
+  int a = bestA, j = bestJ;
+  for (;;) {
+    const unsigned char t = trace[a][j - traceStart[a]];
+
+    if (state == StateE) {
+      addItem(result, CigarItem::RefGap, 3);
+      j -= 3;
+      state = (t & RefGapExtend) ? StateE : StateH;
+    } else if (state == StateF) {
+      addItem(result, CigarItem::QueryGap, 3);
+      --a;
+      state = (t & QueryGapExtend) ? StateF : StateH;
+    } else {
+      const int from = t & FromMask;
+
+      if (from == FromStart) {
+	addItem(result, CigarItem::QueryGap, 3 * a);
+	addItem(result, CigarItem::RefGap, j);
+	break;
+      } else if (from == FromMatch) {
+	addItem(result, CigarItem::Match, 3);
+	--a;
+	j -= 3;
+      } else if (from == FromRefGap)
+	state = StateE;
+      else if (from == FromQueryGap)
+	state = StateF;
+      else if (from < FromQueryShift) {
+	const int k = from - FromRefShift + 1;
+	addItem(result, CigarItem::RefGap, k);
+	j -= k;
+      } else {
+	const int k = from - FromQueryShift + 1;
+	addItem(result, CigarItem::QueryGap, 3 - k);
+	addItem(result, CigarItem::Match, k);
+	--a;
+	j -= k;
+      }
+    }
+  }
+
+  std::reverse(result.begin(), result.end());
+
+  return result;
+}
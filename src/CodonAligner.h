@@ -0,0 +1,72 @@
+// This may look like C code, but it's really -*- C++ -*-
+/*
+ * Copyright Emweb BVBA, 3020 Herent, Belgium
+ *
+ * See LICENSE.txt for terms of use.
+ */
+#ifndef CODON_ALIGNER_H_
+#define CODON_ALIGNER_H_
+
+#include "GenomeScorer.h"
+#include "NTSequence6AA.h"
+#include "SearchRange.h"
+#include "Cigar.h"
+
+/*
+ * A coarse global alignment at codon resolution, as a cheap first
+ * pass that provides a band for the alignment with GlobalAligner.
+ *
+ * The reference advances by whole codons (three positions), and the
+ * query by three nucleotides in a match or a gap, or by one or two
+ * nucleotides in an explicit frameshift transition. A match of a
+ * codon is scored with the nucleotide scores of its three positions
+ * and the amino acid scores of the codons that start within it (see
+ * Genome::codons()), and gaps with the costs of Genome::gapCosts(),
+ * so that the coarse alignment follows the reading frames of the CDS
+ * features. This visits a third of the cells of the full alignment,
+ * with three states instead of the nine of the codon-aware scoring.
+ *
+ * The result is a nucleotide alignment that is only as precise as a
+ * codon: it is meant as a seed for getSearchRange().
+ */
+class CodonAligner
+{
+public:
+  CodonAligner(const GenomeScorer& scorer);
+
+  /* The scorer, for its end gap settings */
+  GenomeScorer& scorer() { return scorer_; }
+
+  /*
+   * Aligns the query against the reference (preprocessed with the
+   * scorer), within the search range.
+   */
+  Cigar align(const Genome& ref, const NTSequence6AA& query,
+	      const SearchRange& sr) const;
+
+private:
+  GenomeScorer scorer_;
+
+  static const int INVALID_SCORE;
+
+  /*
+   * Traceback of a cell, packed in a byte: the transition into H, and
+   * whether E and F extend a gap or open it from H.
+   */
+  enum {
+    FromMatch = 0,
+    FromRefGap = 1,      // E
+    FromQueryGap = 2,    // F
+    FromRefShift = 3,    // + k - 1: k query nucleotides against no codon
+    FromQueryShift = 5,  // + k - 1: k query nucleotides against a codon
+    FromStart = 7,
+    FromMask = 0x07,
+    RefGapExtend = 0x08,
+    QueryGapExtend = 0x10
+  };
+
+  int scoreMatch(const Genome& ref, const NTSequence6AA& query,
+		 int refI, int queryI) const;
+};
+
+#endif // CODON_ALIGNER_H_
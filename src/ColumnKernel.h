@@ -0,0 +1,415 @@
+// This may look like C code, but it's really -*- C++ -*-
+/*
+ * Copyright Emweb BVBA, 3020 Herent, Belgium
+ *
+ * See LICENSE.txt for terms of use.
+ */
+#ifndef COLUMN_KERNEL_H_
+#define COLUMN_KERNEL_H_
+
+#include <vector>
+#include <algorithm>
+#include <limits>
+
+#include "Cigar.h"
+
+/*
+ * The kernel is compiled for several instruction sets, and the best
+ * one supported by the CPU is selected at load time (using cpuid).
+ */
+#if defined(__GNUC__) && !defined(__clang__) && defined(__x86_64__) \
+  && defined(__linux__)
+#define KERNEL_TARGET_CLONES \
+  __attribute__((target_clones("avx512f", "avx2", "sse4.1", "default")))
+#else
+#define KERNEL_TARGET_CLONES
+#endif
+
+/*
+ * Computes one column of the GlobalAligner recurrence (for SideN > 0)
+ * over a range of rows, in three passes:
+ *  - M, Q[k] and the best query gap, which only depend on the
+ *    previous column,
+ *  - P[k] and the best ref gap, which depend on the previous row,
+ *  - D and the traceback.
+ *
+ * The first and the last pass have no dependencies between rows and
+ * are vectorized, the second pass is a sequential scan.
+ *
+ * A column stores its scores as one plane of rows per state. With
+ * Lanes > 1, several queries are aligned in lockstep against the same
+ * reference, and every row holds one score for each lane (query) in
+ * a plane. The scan then also vectorizes, over the lanes.
+ *
+ * Scores are int. With a single lane, the scan and setting the costs
+ * take most of the time of a column, and neither gets faster with
+ * 16-bit scores: these would need to be relative to an offset per
+ * column, and the scan would need to keep scores that are derived
+ * from invalid ones out of the range of valid scores, in every row.
+ *
+ * The costs of a column need to be set using setCosts() before run().
+ */
+template <int SideN, int Lanes = 1>
+class ColumnKernel
+{
+public:
+  /* States, as plane index in a column */
+  enum {
+    StateD = 0,
+    StateM = 1,
+    StateQ = 2,          // + k
+    StateP = 2 + SideN,  // + k
+    StateCount = 2 + 2 * SideN
+  };
+
+  /* The score of a cell that is not computed */
+  static const int InvalidScore = std::numeric_limits<int>::min() / 2;
+
+  /*
+   * Traceback of a cell, packed in a byte: the predecessor of D, and
+   * for Q[0] and P[0] whether the gap was opened from M (or else
+   * extends Q[SideN - 1] or P[SideN - 1]). Q[k] and P[k] with k > 0
+   * always extend Q[k - 1] and P[k - 1].
+   */
+  typedef unsigned char TraceCell;
+
+  enum {
+    FromMatch = 0,          // M
+    FromQueryGapOpen = 1,   // M in the previous column
+    FromRefGapOpen = 2,     // M in the previous row
+    FromQueryGap = 3,       // + k: Q[k] in the previous column
+    FromRefGap = 3 + SideN, // + k: P[k] in the previous row
+    FromMask = 0x0F,
+    QueryGapOpen = 0x10,
+    RefGapOpen = 0x20
+  };
+
+  static_assert(FromRefGap + SideN <= FromMask + 1,
+		"SideN too large for the traceback encoding");
+
+  /*
+   * A kernel for columns of rows rows, where row r of the column is
+   * row firstRow + r of the matrix.
+   */
+  ColumnKernel(int rows, int firstRow = 0);
+
+  /*
+   * Sets the costs for column i (ref position i), rows [from, to),
+   * for the query of each lane. Rows past the end of a query get
+   * costs 0.
+   *
+   * The costs are taken from the column scorer that the scorer
+   * passes to its forColumn(), which may be specialized for column i.
+   */
+  template <class Scorer, class Reference, class Query>
+  void setCosts(Scorer& scorer, const Reference& ref,
+		const Query *const *queries, int i, int from, int to);
+
+  /*
+   * Computes rows [from, to) of column cur from column prev, with
+   * from > 0, and the traceback for these rows in trace[0 .. (to -
+   * from) * Lanes). Cells outside the computed rows must hold invalid
+   * scores.
+   */
+  KERNEL_TARGET_CLONES
+  void run(int from, int to, const int *prev, int *cur, TraceCell *trace);
+
+  /*
+   * One step of the traceback from the cell (hi, hj), with hi > 0 and
+   * hj > 0, in the given state, using the traceback t of that cell:
+   * returns the op and moves to the previous cell and state.
+   */
+  static CigarItem::Op traceBack(TraceCell t, int& state, int& hi, int& hj);
+
+private:
+  int rows_, firstRow_;
+
+  std::vector<int> extend_, openQueryGap_, openRefGap_;
+  std::vector<int> extendQueryGap_[SideN], extendRefGap_[SideN];
+
+  std::vector<int> hgap_, vgap_;
+  std::vector<TraceCell> hgapTrace_;
+  std::vector<int> vgapTrace_; // int, so that the scan vectorizes over lanes
+
+  template <class Query>
+  struct CostSetter {
+    CostSetter(ColumnKernel& aKernel, const Query *const *someQueries,
+	       int aFrom, int aTo)
+      : kernel(aKernel), queries(someQueries), from(aFrom), to(aTo)
+    { }
+
+    template <class Column>
+    void operator()(const Column& column) {
+      kernel.setColumnCosts(column, queries, from, to);
+    }
+
+    ColumnKernel& kernel;
+    const Query *const *queries;
+    int from, to;
+  };
+
+  template <class Column, class Query>
+  void setColumnCosts(const Column& column, const Query *const *queries,
+		      int from, int to);
+};
+
+template <int SideN, int Lanes>
+const int ColumnKernel<SideN, Lanes>::InvalidScore;
+
+template <int SideN, int Lanes>
+ColumnKernel<SideN, Lanes>::ColumnKernel(int rows, int firstRow)
+  : rows_(rows),
+    firstRow_(firstRow),
+    extend_(rows * Lanes),
+    openQueryGap_(rows * Lanes),
+    openRefGap_(rows * Lanes),
+    hgap_(rows * Lanes),
+    vgap_(rows * Lanes),
+    hgapTrace_(rows * Lanes),
+    vgapTrace_(rows * Lanes)
+{
+  for (int k = 0; k < SideN; ++k) {
+    extendQueryGap_[k].resize(rows * Lanes);
+    extendRefGap_[k].resize(rows * Lanes);
+  }
+}
+
+template <int SideN, int Lanes>
+template <class Scorer, class Reference, class Query>
+void ColumnKernel<SideN, Lanes>::setCosts(Scorer& scorer, const Reference& ref,
+					  const Query *const *queries,
+					  int i, int from, int to)
+{
+  CostSetter<Query> setter(*this, queries, from, to);
+  scorer.forColumn(ref, i, setter);
+}
+
+template <int SideN, int Lanes>
+template <class Column, class Query>
+void ColumnKernel<SideN, Lanes>::setColumnCosts(const Column& column,
+					       const Query *const *queries,
+					       int from, int to)
+{
+  for (int l = 0; l < Lanes; ++l) {
+    const Query& query = *queries[l];
+    const int end = std::min(to, (int)query.size() + 1 - firstRow_);
+
+    for (int hj = from; hj < end; ++hj) {
+      int j = firstRow_ + hj - 1;
+      int c = hj * Lanes + l;
+
+      extend_[c] = column.scoreExtend(query, j);
+      openQueryGap_[c] = column.scoreOpenQueryGap(query, j);
+      openRefGap_[c] = column.scoreOpenRefGap(query, j);
+
+      for (int k = 0; k < SideN; ++k) {
+	extendQueryGap_[k][c] = column.scoreExtendQueryGap(query, j, k);
+	extendRefGap_[k][c] = column.scoreExtendRefGap(query, j, k);
+      }
+    }
+
+    for (int hj = std::max(from, end); hj < to; ++hj) {
+      int c = hj * Lanes + l;
+
+      extend_[c] = openQueryGap_[c] = openRefGap_[c] = 0;
+      for (int k = 0; k < SideN; ++k)
+	extendQueryGap_[k][c] = extendRefGap_[k][c] = 0;
+    }
+  }
+}
+
+template <int SideN, int Lanes>
+void ColumnKernel<SideN, Lanes>::run(int from, int to, const int *prev,
+				     int *cur, TraceCell *trace)
+{
+  /* n and r run over the cells of all lanes */
+  const int n = (to - from) * Lanes;
+  const int plane = rows_ * Lanes;
+  const int first = from * Lanes;
+
+  const int *pD = prev + StateD * plane + first;
+  const int *pM = prev + StateM * plane + first;
+  const int *pQ[SideN];
+
+  int *cD = cur + StateD * plane + first;
+  int *cM = cur + StateM * plane + first;
+  int *cQ[SideN], *cP[SideN];
+
+  for (int k = 0; k < SideN; ++k) {
+    pQ[k] = prev + (StateQ + k) * plane + first;
+    cQ[k] = cur + (StateQ + k) * plane + first;
+    cP[k] = cur + (StateP + k) * plane + first;
+  }
+
+  const int *extend = &extend_[first];
+  const int *openQueryGap = &openQueryGap_[first];
+  const int *openRefGap = &openRefGap_[first];
+  const int *extendQueryGap[SideN], *extendRefGap[SideN];
+  for (int k = 0; k < SideN; ++k) {
+    extendQueryGap[k] = &extendQueryGap_[k][first];
+    extendRefGap[k] = &extendRefGap_[k][first];
+  }
+
+  int *hgap = &hgap_[first];
+  int *vgap = &vgap_[first];
+  TraceCell *hgapTrace = &hgapTrace_[first];
+  int *vgapTrace = &vgapTrace_[first];
+
+  /* M and gaps in the query */
+#pragma GCC ivdep
+  for (int r = 0; r < n; ++r) {
+    cM[r] = pD[r - Lanes] + extend[r];
+
+    int sopen = pM[r] + openQueryGap[r];
+    int s = sopen;
+    TraceCell t = FromQueryGapOpen;
+
+    for (int k = 0; k < SideN; ++k) {
+      int kN = (k + 1) % SideN;
+      int sK = pQ[k][r] + extendQueryGap[kN][r];
+
+      if (k == SideN - 1) {
+	bool open = sopen > sK;
+	cQ[0][r] = open ? sopen : sK;
+	t |= open ? (TraceCell)QueryGapOpen : (TraceCell)0;
+      } else
+	cQ[kN][r] = sK;
+
+      /* if the gap was opened, then sK < sopen <= s */
+      t = sK > s ? (TraceCell)((t & QueryGapOpen) | (FromQueryGap + k)) : t;
+      s = sK > s ? sK : s;
+    }
+
+    hgap[r] = s;
+    hgapTrace[r] = t;
+  }
+
+  /*
+   * Gaps in the reference: a scan along the column, row by row for
+   * all lanes at once
+   */
+  int upM[Lanes], upP[SideN][Lanes];
+  for (int l = 0; l < Lanes; ++l) {
+    upM[l] = cM[l - Lanes];
+    for (int k = 0; k < SideN; ++k)
+      upP[k][l] = cP[k][l - Lanes];
+  }
+
+  for (int r0 = 0; r0 < n; r0 += Lanes) {
+    int s[Lanes];
+    int t[Lanes];
+
+#pragma GCC ivdep
+#pragma GCC unroll 1
+    for (int l = 0; l < Lanes; ++l) {
+      const int r = r0 + l;
+
+      int sopen = upM[l] + openRefGap[r];
+      s[l] = sopen;
+      t[l] = FromRefGapOpen;
+
+      int p[SideN];
+      for (int k = 0; k < SideN; ++k) {
+	int kN = (k + 1) % SideN;
+	int sK = upP[k][l] + extendRefGap[kN][r];
+
+	if (k == SideN - 1) {
+	  bool open = sopen > sK;
+	  p[0] = open ? sopen : sK;
+	  t[l] |= open ? RefGapOpen : 0;
+	} else
+	  p[kN] = sK;
+
+	t[l] = sK > s[l] ? (t[l] & RefGapOpen) | (FromRefGap + k) : t[l];
+	s[l] = sK > s[l] ? sK : s[l];
+      }
+
+      for (int k = 0; k < SideN; ++k)
+	upP[k][l] = p[k];
+    }
+
+    for (int l = 0; l < Lanes; ++l)
+      upM[l] = cM[r0 + l];
+
+    for (int l = 0; l < Lanes; ++l) {
+      for (int k = 0; k < SideN; ++k)
+	cP[k][r0 + l] = upP[k][l];
+      vgap[r0 + l] = s[l];
+      vgapTrace[r0 + l] = t[l];
+    }
+  }
+
+  /* D and traceback */
+#pragma GCC ivdep
+  for (int r = 0; r < n; ++r) {
+    int sextend = cM[r], shgap = hgap[r], svgap = vgap[r];
+    TraceCell ht = hgapTrace[r], vt = vgapTrace[r];
+
+    TraceCell t = (ht & QueryGapOpen) | (vt & RefGapOpen);
+
+    bool match = sextend > shgap && sextend > svgap;
+    bool hgapBest = shgap > svgap;
+
+    cD[r] = match ? sextend : (hgapBest ? shgap : svgap);
+    trace[r] = t | (match ? (TraceCell)FromMatch
+		    : (TraceCell)((hgapBest ? ht : vt) & FromMask));
+  }
+}
+
+template <int SideN, int Lanes>
+CigarItem::Op ColumnKernel<SideN, Lanes>::traceBack(TraceCell t, int& state,
+						    int& hi, int& hj)
+{
+  const int from = t & FromMask;
+
+  CigarItem::Op op;
+
+  if (state == StateD && from != FromMatch) {
+    if (from == FromQueryGapOpen
+	|| (from >= FromQueryGap && from < FromRefGap)) {
+      op = CigarItem::QueryGap;
+      --hi;
+    } else {
+      op = CigarItem::RefGap;
+      --hj;
+    }
+
+    if (from == FromQueryGapOpen || from == FromRefGapOpen)
+      state = StateM;
+    else if (op == CigarItem::QueryGap)
+      state = StateQ + from - FromQueryGap;
+    else
+      state = StateP + from - FromRefGap;
+  } else if (state == StateD || state == StateM) {
+    op = CigarItem::Match;
+    --hi;
+    --hj;
+    state = StateD;
+  } else if (state < StateP) {
+    op = CigarItem::QueryGap;
+    --hi;
+    if (state > StateQ)
+      --state;
+    else if (t & QueryGapOpen)
+      state = StateM;
+    else
+      state = StateQ + SideN - 1;
+  } else {
+    op = CigarItem::RefGap;
+    --hj;
+    if (state > StateP)
+      --state;
+    else if (t & RefGapOpen)
+      state = StateM;
+    else
+      state = StateP + SideN - 1;
+  }
+
+  /* Without gap states, a gap continues from D */
+  if (SideN == 0 && state == StateM)
+    state = StateD;
+
+  return op;
+}
+
+#endif // COLUMN_KERNEL_H_
@@ -0,0 +1,111 @@
+/*
+ * Copyright Emweb BVBA, 3020 Herent, Belgium
+ *
+ * See LICENSE.txt for terms of use.
+ */
+
+#include "EditDistance.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace {
+
+typedef std::uint64_t Word;
+
+const int WordSize = 64;
+const int SymbolCount = seq::Nucleotide::NT_MISSING + 1;
+
+/*
+ * The vertical deltas of a block of rows (bit set in P: +1, in M:
+ * -1), and the score of its last row in the current column.
+ */
+struct Block {
+  Word P, M;
+  int score;
+};
+
+/*
+ * Advances a block by one column, given the horizontal delta into its
+ * first row (hin), and returns the delta out of its last row.
+ */
+int advance(Block& b, Word eq, int hin)
+{
+  const Word xv = eq | b.M;
+  if (hin < 0)
+    eq |= 1;
+  const Word xh = (((eq & b.P) + b.P) ^ b.P) | eq;
+
+  Word ph = b.M | ~(xh | b.P);
+  Word mh = b.P & xh;
+
+  const Word high = Word(1) << (WordSize - 1);
+  int hout = 0;
+  if (ph & high)
+    hout = 1;
+  else if (mh & high)
+    hout = -1;
+
+  ph <<= 1;
+  mh <<= 1;
+  if (hin < 0)
+    mh |= 1;
+  else if (hin > 0)
+    ph |= 1;
+
+  b.P = mh | ~(xv | ph);
+  b.M = ph & xv;
+  b.score += hout;
+
+  return hout;
+}
+
+}
+
+int editDistance(const seq::NTSequence& ref, const seq::NTSequence& query)
+{
+  const int m = query.size();
+  if (m == 0)
+    return ref.size();
+
+  const int blocks = (m + WordSize - 1) / WordSize;
+
+  /* The rows of each block in which the query has a symbol */
+  std::vector<Word> peq(SymbolCount * blocks, 0);
+  for (int i = 0; i < m; ++i)
+    peq[query[i].intRep() * blocks + i / WordSize]
+      |= Word(1) << (i % WordSize);
+
+  /* The first column: the distance of row i is i */
+  std::vector<Block> column(blocks);
+  for (int b = 0; b < blocks; ++b) {
+    column[b].P = ~Word(0);
+    column[b].M = 0;
+    column[b].score = (b + 1) * WordSize;
+  }
+
+  for (unsigned j = 0; j < ref.size(); ++j) {
+    const Word *eq = &peq[ref[j].intRep() * blocks];
+
+    /* The first row: the distance of column j is j */
+    int hin = 1;
+    for (int b = 0; b < blocks; ++b)
+      hin = advance(column[b], eq[b], hin);
+  }
+
+  /*
+   * The score of the last block is of its last row: walk back up to
+   * the last row of the query.
+   */
+  const Block& last = column[blocks - 1];
+  int result = last.score;
+  for (int i = blocks * WordSize - 1; i >= m; --i) {
+    const int bit = i % WordSize;
+    if (last.P & (Word(1) << bit))
+      --result;
+    else if (last.M & (Word(1) << bit))
+      ++result;
+  }
+
+  return result;
+}
@@ -0,0 +1,23 @@
+// This may look like C code, but it's really -*- C++ -*-
+/*
+ * Copyright Emweb BVBA, 3020 Herent, Belgium
+ *
+ * See LICENSE.txt for terms of use.
+ */
+#ifndef EDIT_DISTANCE_H_
+#define EDIT_DISTANCE_H_
+
+#include "NTSequence.h"
+
+/*
+ * The (unit cost) edit distance between two sequences, aligned end to
+ * end, computed with the bit-parallel algorithm of Myers, in blocks
+ * of 64 rows (Hyyro) of the query, in O(ref * query / 64).
+ *
+ * Nucleotides match only when they are the same symbol, so that this
+ * is an estimate of divergence rather than of the alignment score.
+ */
+extern int editDistance(const seq::NTSequence& ref,
+			const seq::NTSequence& query);
+
+#endif // EDIT_DISTANCE_H_
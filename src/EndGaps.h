@@ -0,0 +1,33 @@
+// This may look like C code, but it's really -*- C++ -*-
+/*
+ * Copyright Emweb BVBA, 3020 Herent, Belgium
+ *
+ * See LICENSE.txt for terms of use.
+ */
+#ifndef END_GAPS_H_
+#define END_GAPS_H_
+
+#include "Cigar.h"
+
+/*
+ * Converts the gaps at the start and the end of a global alignment
+ * that the scorer does not score into skipped positions.
+ */
+template <class Scorer>
+void convertEndGaps(const Scorer& scorer, Cigar& cigar)
+{
+  if (!cigar.empty()) {
+    auto& first = cigar[0];
+    if (!scorer.scoreRefStartGap() && first.isRefGap())
+      first = CigarItem(CigarItem::QuerySkipped, first.length());
+    else if (!scorer.scoreQueryStartGap() && first.isQueryGap())
+      first = CigarItem(CigarItem::RefSkipped, first.length());
+    auto& last = cigar[cigar.size() - 1];
+    if (!scorer.scoreRefEndGap() && last.isRefGap())
+      last = CigarItem(CigarItem::QuerySkipped, last.length());
+    else if (!scorer.scoreQueryEndGap() && last.isQueryGap())
+      last = CigarItem(CigarItem::RefSkipped, last.length());
+  }
+}
+
+#endif // END_GAPS_H_
@@ -215,6 +215,46 @@ CdsFeature CdsFeature::unwrapLinear(int length) const
   return result;
 }
 
+CdsFeature CdsFeature::crop(int start, int end) const
+{
+  CdsFeature result(*this);
+  result.location.clear();
+
+  /*
+   * The CDS nucleotides within the window, rounded inwards to codon
+   * boundaries: since the CDS length is a multiple of 3, these are
+   * also the codon boundaries of a reverse complemented feature.
+   */
+  int cdsStart = -1, cdsEnd = -1;
+  int cdsPos = 0;
+  for (auto& r : location) {
+    int s = std::max(r.start, start), e = std::min(r.end, end);
+    if (s < e) {
+      if (cdsStart < 0)
+	cdsStart = cdsPos + (s - r.start);
+      cdsEnd = cdsPos + (e - r.start);
+    }
+    cdsPos += r.end - r.start;
+  }
+
+  if (cdsStart < 0)
+    return result;
+
+  cdsStart = (cdsStart + 2) / 3 * 3;
+  cdsEnd = cdsEnd / 3 * 3;
+
+  cdsPos = 0;
+  for (auto& r : location) {
+    int s = std::max(r.start, r.start + cdsStart - cdsPos);
+    int e = std::min(r.end, r.start + cdsEnd - cdsPos);
+    if (s < e)
+      result.location.push_back(Region(s - start, e - start));
+    cdsPos += r.end - r.start;
+  }
+
+  return result;
+}
+
 CodingSequence::CodingSequence()
 { }
 
@@ -276,16 +316,20 @@ void Genome::clearCdsFeatures()
 }
 
 
-void Genome::preprocess(int ntWeight, int aaWeight)
+void Genome::preprocess(const GenomeScorer& scorer)
 {
+  const int ntWeight = scorer.ntWeight();
+  const int aaWeight = scorer.aaWeight();
+
   cdsAa_.clear();
-  cdsAa_.resize(size());
-  ntWeight_.resize(size());
-  aaWeight_.resize(size());
+  codons_.clear();
+  positions_.resize(size());
 
   int maxAaPerNt = 0;
 
   for (int i = 0; i < size(); ++i) {
+    const unsigned start = cdsAa_.size();
+
     for (const auto& f : cdsFeatures()) {
       int t = f.getCdsNucleotidePos(i);
       if (t >= 0) {
@@ -308,24 +352,40 @@ void Genome::preprocess(int ntWeight, int aaWeight)
 #endif // CHECKTHAT
 
 	bool add = true;
-	for (auto p2 : cdsAa_[i])
-	  if (p2.i == p.i && p2.reverseComplement == p.reverseComplement) {
+	for (unsigned j = start; j < cdsAa_.size(); ++j)
+	  if (cdsAa_[j].i == p.i
+	      && cdsAa_[j].reverseComplement == p.reverseComplement) {
 	    add = false;
 	    break;
 	  }
 
 	if (add)
-	  cdsAa_[i].push_back(p);
+	  cdsAa_.push_back(p);
       }
     }
-    if (cdsAa_[i].size() > maxAaPerNt)
-      maxAaPerNt = cdsAa_[i].size();
+
+    GenomePosition& pos = positions_[i];
+    pos.cdsStart = start;
+    pos.cdsCount = cdsAa_.size() - start;
+    if (pos.cdsCount > maxAaPerNt)
+      maxAaPerNt = pos.cdsCount;
+
+    pos.codonStart = codons_.size();
+    for (unsigned j = start; j < cdsAa_.size(); ++j)
+      if (cdsAa_[j].i == 0) {
+	CdsCodon c;
+	c.aa = cdsAa_[j].aa.intRep();
+	c.reverseComplement = cdsAa_[j].reverseComplement;
+	codons_.push_back(c);
+      }
+    pos.codonCount = codons_.size() - pos.codonStart;
   }
 
   // ntWeight x ntScore + aaWeight x avg(aaScore)
   std::vector<int> totals;
-  for (unsigned i = 1; i <= maxAaPerNt; ++i)
-    totals.push_back(i * aaWeight);
+  if (aaWeight > 0)
+    for (unsigned i = 1; i <= maxAaPerNt; ++i)
+      totals.push_back(i * aaWeight);
 
   // find smallest common multiple of numbers in totals()
   int l = lcm(totals);
@@ -333,23 +393,63 @@ void Genome::preprocess(int ntWeight, int aaWeight)
   std::vector<int> factors;
   std::vector<int> counts(1 + totals.size());
 
-  for (unsigned i = 1; i <= maxAaPerNt; ++i) {
+  for (unsigned i = 1; i <= totals.size(); ++i) {
     int factor = l / totals[i - 1];
     factors.push_back(factor);
   }
 
+  scoreFactor_ = 1;
   int theNtWeight = ntWeight;
   if (factors.size() > 0) {
     scoreFactor_ = factors[0];
     theNtWeight = scoreFactor_ * ntWeight;
   }
 
+  const auto& nt = scorer.nucleotideScorer();
+  const auto& aa = scorer.aminoAcidScorer();
+
   for (int i = 0; i < size(); ++i) {
-    int aaCount = cdsAa_[i].size();
+    GenomePosition& pos = positions_[i];
+
+    int aaCount = pos.cdsCount;
     counts[aaCount]++;
-    ntWeight_[i] = theNtWeight;
-    if (aaCount > 0)
-      aaWeight_[i] = aaWeight * factors[aaCount - 1];
+    pos.ntWeight = theNtWeight;
+    pos.aaWeight = aaCount > 0 && aaWeight > 0
+      ? aaWeight * factors[aaCount - 1] : 0;
+
+    int aaOpen = 0;
+    int aaExtendRef[3] = { 0, 0, 0 }, aaExtendQuery[3] = { 0, 0, 0 };
+
+    for (const auto& p : cdsAa(i)) {
+      aaOpen += aa.frameShiftCost() + aa.gapOpenCost();
+
+      aaExtendRef[0] += aa.frameShiftCost() + aa.gapExtendCost();
+      if (p.cdsRegionI != 0)
+	aaExtendRef[2] -= aa.frameShiftCost();
+
+      aaExtendQuery[0] += aa.frameShiftCost() + aa.gapExtendCost();
+      aaExtendQuery[2] -= aa.frameShiftCost();
+      if (p.cdsRegionI == 0 && p.i == 0)
+	for (int k = 1; k < 3; ++k)
+	  aaExtendQuery[k] += aa.frameShiftCost() + aa.misalignmentCost();
+    }
+
+    /* query gaps are scored as a gap extended after i - 1 */
+    if (i == 0) {
+      for (int k = 0; k < 3; ++k)
+	aaExtendQuery[k] = 0;
+    }
+
+    GapCosts& c = pos.gapCosts;
+    c.openRef = pos.ntWeight * nt.gapOpenCost() + pos.aaWeight * aaOpen;
+    c.openQuery = pos.ntWeight * nt.gapOpenCost()
+      + (i > 0 ? pos.aaWeight * aaOpen : 0);
+    for (int k = 0; k < 3; ++k) {
+      c.extendRef[k] = pos.ntWeight * nt.gapExtendCost()
+	+ pos.aaWeight * aaExtendRef[k];
+      c.extendQuery[k] = pos.ntWeight * nt.gapExtendCost()
+	+ pos.aaWeight * aaExtendQuery[k];
+    }
   }
 
   /*
@@ -679,12 +779,30 @@ Genome unwrapLinear(const Genome& genome, const GenomeScorer& scorer)
     }
   }
 
-  linearized.preprocess(scorer.ntWeight(),
-			scorer.aaWeight());
+  linearized.preprocess(scorer);
 
   return linearized;
 }
 
+Genome cropGenome(const Genome& genome, int start, int end,
+		  const GenomeScorer& scorer)
+{
+  Genome result(seq::NTSequence(genome.begin() + start,
+				genome.begin() + end),
+		Genome::Geometry::Linear);
+  result.setName(genome.name());
+
+  for (const auto& f : genome.cdsFeatures()) {
+    CdsFeature f2 = f.crop(start, end);
+    if (!f2.location.empty())
+      result.addCdsFeature(f2);
+  }
+
+  result.preprocess(scorer);
+
+  return result;
+}
+
 void optimizeMisaligned(CDSAlignment& alignment,
 			const SimpleScorer<seq::AASequence>& scorer)
 {
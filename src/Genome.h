@@ -8,6 +8,7 @@
 #define GENOME_H_
 
 #include <vector>
+#include <cstdint>
 #include "AASequence.h"
 #include "NTSequence.h"
 #include "Cigar.h"
@@ -22,6 +23,57 @@ struct CdsPosition {
   int cdsRegionI;
 };
 
+/*
+ * A codon that starts at a genome position (CdsPosition::i == 0),
+ * as needed to score the amino acid of a match at that position.
+ */
+struct CdsCodon {
+  std::int8_t aa; // seq::AminoAcid::intRep()
+  bool reverseComplement;
+};
+
+/*
+ * The weighted costs of gaps at a genome position that do not depend
+ * on the query (see GenomeScorer), for a gap that does not touch an
+ * end of the reference or query. Gap extensions are by the old gap
+ * length k % 3.
+ */
+struct GapCosts {
+  int openRef, openQuery;
+  int extendRef[3], extendQuery[3];
+};
+
+/*
+ * The scoring data of a genome position: its score weights and gap
+ * costs, and its CDS positions and codons as ranges in the flat
+ * arrays of the Genome.
+ */
+struct GenomePosition {
+  int ntWeight, aaWeight;
+  int cdsStart, codonStart;
+  std::uint8_t cdsCount, codonCount;
+  GapCosts gapCosts;
+};
+
+/*
+ * A range [begin, end) of a flat array.
+ */
+template <typename T>
+class ArrayRange
+{
+public:
+  ArrayRange(const T *begin, int size)
+    : begin_(begin), end_(begin + size)
+  { }
+
+  const T *begin() const { return begin_; }
+  const T *end() const { return end_; }
+  int size() const { return end_ - begin_; }
+
+private:
+  const T *begin_, *end_;
+};
+
 struct Range
 {
   int start, end; // C conventions, start < end
@@ -83,6 +135,13 @@ struct CdsFeature
   bool wraps(int length) const;
   CdsFeature shift(int offset) const;
   CdsFeature unwrapLinear(int length) const;  
+
+  /*
+   * The part of the feature within the genome positions [start, end),
+   * in the coordinates of that window, and trimmed to whole codons.
+   * Its location is empty if no codon is left.
+   */
+  CdsFeature crop(int start, int end) const;
   
   bool complement;
   std::string locationStr;
@@ -109,19 +168,37 @@ public:
   const std::vector<CdsFeature>& cdsFeatures() const { return cdsFeatures_; }
   void clearCdsFeatures();
 
-  void preprocess(int ntWeight, int aaWeight);
+  /*
+   * Computes the score weights, the codons and the gap costs of all
+   * positions, for scoring with the given scorer.
+   */
+  void preprocess(const GenomeScorer& scorer);
 
-  const std::vector<CdsPosition>& cdsAa(int pos) const { return cdsAa_[pos]; }
+  const GenomePosition& position(int pos) const { return positions_[pos]; }
+
+  ArrayRange<CdsPosition> cdsAa(int pos) const {
+    const GenomePosition& p = positions_[pos];
+    return ArrayRange<CdsPosition>(cdsAa_.data() + p.cdsStart, p.cdsCount);
+  }
+
+  /* The codons starting at pos */
+  ArrayRange<CdsCodon> codons(int pos) const {
+    const GenomePosition& p = positions_[pos];
+    return ArrayRange<CdsCodon>(codons_.data() + p.codonStart, p.codonCount);
+  }
+
+  const GapCosts& gapCosts(int pos) const { return positions_[pos].gapCosts; }
 
   int scoreFactor() const { return scoreFactor_; }
-  int ntWeight(int pos) const { return ntWeight_[pos]; }
-  int aaWeight(int pos) const { return aaWeight_[pos]; }
+  int ntWeight(int pos) const { return positions_[pos].ntWeight; }
+  int aaWeight(int pos) const { return positions_[pos].aaWeight; }
   std::vector<seq::NTSequence> nonCodingSequences(int minLength) const;
 
 private:
   std::vector<CdsFeature> cdsFeatures_;
-  std::vector<std::vector<CdsPosition>> cdsAa_;
-  std::vector<int> aaWeight_, ntWeight_;
+  std::vector<GenomePosition> positions_;
+  std::vector<CdsPosition> cdsAa_;
+  std::vector<CdsCodon> codons_;
   int scoreFactor_;
   Geometry geometry_;
 };
@@ -190,6 +267,14 @@ extern Genome readGenome(const std::string& fasta, const std::string& cds,
 
 extern Genome unwrapLinear(const Genome& genome, const GenomeScorer& scorer);
 
+/*
+ * The window [start, end) of a (linear) genome, with its CDS features
+ * cropped to whole codons (see CdsFeature::crop()), and preprocessed
+ * with the scorer.
+ */
+extern Genome cropGenome(const Genome& genome, int start, int end,
+			 const GenomeScorer& scorer);
+
 template <class Scorer, class Reference, class Query>
 double calcConcordance(const Reference& alignedRef,
 		       const Query& alignedQuery,
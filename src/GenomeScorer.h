@@ -24,8 +24,14 @@ public:
     : ntScorer_(nucleotideScorer),
       aaScorer_(aminoAcidScorer),
       ntWeight_(ntWeight),
-      aaWeight_(aaWeight)
-  { }
+      aaWeight_(aaWeight),
+      aaMatrix_(AaCount * AaCount)
+  {
+    const int **m = aaScorer_.weightMatrix();
+    for (int i = 0; i < AaCount; ++i)
+      for (int j = 0; j < AaCount; ++j)
+	aaMatrix_[i * AaCount + j] = m[i][j];
+  }
 
   void setScoreRefStartGap(bool enabled) {
     ntScorer_.setScoreRefStartGap(enabled);
@@ -79,198 +85,215 @@ public:
     return aaWeight_;
   }
 
-  int scoreExtend(const Genome& ref, const NTSequence6AA& query,
-		  unsigned refI, unsigned queryI)
+  enum { AnyCds = -1 };
+
+  /*
+   * The scores of the cells in column refI, as computed by the cell
+   * scores of GenomeScorer (except for refI == -1).
+   *
+   * A column is specialized for the number of CDS positions at refI
+   * (CdsCount, or AnyCds for any number), since most positions are
+   * either non-coding (no amino acid scoring at all) or in a single
+   * reading frame.
+   *
+   * An amino acid is scored with the codons that start at refI (see
+   * Genome::preprocess()) and the translations of the query (see
+   * NTSequence6AA), with a single lookup in aaMatrix_. The gap scores
+   * take the costs that only depend on the reference position from
+   * Genome::gapCosts(), and only add the correction for opening a gap
+   * within a codon, which depends on the query.
+   */
+  template <int CdsCount>
+  class Column
   {
-    int ntResult = ntScorer_.scoreExtend(ref, query, refI, queryI);
-
-    int aaResult = 0;
-    for (const auto& p : ref.cdsAa(refI)) {
-      if (p.i == 0) { // first NT of a codon
-	seq::AminoAcid aaRef = p.aa;
-	seq::AminoAcid aaQuery = query.translate(queryI, p.reverseComplement);
-	aaResult += aaScorer_.scoreExtend(aaRef, aaQuery);
-      }
-    }
+  public:
+    Column(GenomeScorer& scorer, const Genome& ref, int refI)
+      : scorer_(scorer),
+	ref_(ref),
+	refI_(refI),
+	pos_(ref.position(refI)),
+	ntRow_(scorer.ntScorer_.weightMatrix()[ref[refI].intRep()]),
+	cds_(ref.cdsAa(refI).begin()),
+	cdsCount_(CdsCount == AnyCds ? pos_.cdsCount : CdsCount),
+	refEnd_(refI == ref.size() - 1)
+    { }
+
+    int scoreExtend(const NTSequence6AA& query, int queryI) const
+    {
+      int ntResult = ntRow_[query[queryI].intRep()];
+
+      int aaResult = 0;
+      if (CdsCount != 0)
+	for (const auto& c : ref_.codons(refI_))
+	  aaResult += scorer_.aaMatrix_[c.aa * AaCount
+					+ query.aaRep(queryI,
+						      c.reverseComplement)];
 
 #ifdef TRACE
-    std::cerr << "extend: " << ntResult << " " << aaResult << std::endl;
+      std::cerr << "extend: " << ntResult << " " << aaResult << std::endl;
 #endif
-    
-    return ntResult * ref.ntWeight(refI) + aaResult * ref.aaWeight(refI);
-  }
 
-  int scoreOpenRefGap(const Genome& ref, const NTSequence6AA& query,
-		      int refI, int queryI)
-  {
-    if (refI == ref.size() - 1)
-      return
-	ref.ntWeight(refI) * ntScorer_.scoreOpenRefGap(ref, query, refI, queryI);
-    else if (refI == -1)
-      return
-	ref.ntWeight(0) * ntScorer_.scoreOpenRefGap(ref, query, refI, queryI);      
+      return ntResult * pos_.ntWeight + aaResult * pos_.aaWeight;
+    }
 
-    int ntResult = ntScorer_.scoreOpenRefGap(ref, query, refI, queryI);
+    int scoreOpenRefGap(const NTSequence6AA& query, int queryI) const
+    {
+      if (refEnd_)
+	return pos_.ntWeight
+	  * scorer_.ntScorer_.scoreOpenRefGap(ref_, query, refI_, queryI);
 
-    int aaResult = 0;
+      int aaResult = 0;
+
+      // paper: considers ref+1 and p.i == 0, but here we implement using refI and p.i != 2
+      for (int c = 0; c < cdsCount_; ++c) {
+	const CdsPosition& p = cds_[c];
+	/*
+	 * Penalize if we are starting a gap at a non-codon boundary.
+	 * But this should score a gap after refI, hence position 2
+	 */
+	if (p.i != 2 && (int)(queryI - p.i - 1) >= 0)
+	  aaResult += scorer_.misalignmentCorrection(p, query,
+						     queryI - p.i - 1);
+      }
 
-    // paper: considers ref+1 and p.i == 0, but here we implement using refI and p.i != 2
-    for (const auto& p : ref.cdsAa(refI)) {
 #ifdef TRACE
-      std::cerr << "open aa ref gap: ";
+      std::cerr << "open ref: " << pos_.gapCosts.openRef
+		<< " " << aaResult << std::endl;
 #endif
-      /*
-       * Penalize if we are starting a gap at a non-codon boundary.
-       * But this should score a gap after refI, hence position 2
-       */
-      if (p.i != 2 && (int)(queryI - p.i - 1) >= 0) {
-	aaResult += aaScorer_.misalignmentCost();
 
-	seq::AminoAcid aaRef = p.aa;
-	seq::AminoAcid aaQuery = query.translate(queryI - p.i - 1, p.reverseComplement);
-	aaResult -= aaScorer_.scoreExtend(aaRef, aaQuery);
+      return pos_.gapCosts.openRef + aaResult * pos_.aaWeight;
+    }
 
-#ifdef TRACE
-        std::cerr << aaScorer_.misalignmentCost() << " - " << aaRef << "," << aaQuery << ":" << aaScorer_.scoreExtend(aaRef, aaQuery);
-#endif
+    /* k : old gap length mod 3 */
+    int scoreExtendRefGap(const NTSequence6AA& query, int queryI, int k) const
+    {
+      if (refEnd_)
+	return pos_.ntWeight
+	  * scorer_.ntScorer_.scoreExtendRefGap(ref_, query, refI_, queryI, k);
+
+      return pos_.gapCosts.extendRef[k % 3];
+    }
+
+    int scoreOpenQueryGap(const NTSequence6AA& query, int queryI) const
+    {
+      if (queryI == query.size() - 1 || queryI == -1)
+	return pos_.ntWeight
+	  * scorer_.ntScorer_.scoreOpenQueryGap(ref_, query, refI_, queryI);
+
+      int aaResult = 0;
+      if (refI_ > 0) {
+	for (int c = 0; c < cdsCount_; ++c) {
+	  const CdsPosition& p = cds_[c];
+	  /* 
+	   * Penalize if we are starting a gap at a non-codon boundary.
+	   * This should score a gap at refI, hence position 0
+	   */
+	  if (p.i != 0 && (int)(queryI - p.i + 1) >= 0)
+	    aaResult += scorer_.misalignmentCorrection(p, query,
+						       queryI - p.i + 1);
+
+	  /*
+	   * More correctly, we should not score the frameshift (in
+	   * Genome::gapCosts()) for a gap that starts at exactly the
+	   * start of the CDS region, but then we do not know when to
+	   * not cancel the frameshift in extend()
+	   *
+	   * A workaround would be to consider the situation of refI-1
+	   * for query gaps (cfr ~#5bf1d) but that isn't correct either
+	   */
+	}
       }
 
-      aaResult += aaScorer_.frameShiftCost();
-      aaResult += aaScorer_.gapOpenCost();
 #ifdef TRACE
-	std::cerr << " + " << aaScorer_.frameShiftCost() << " + " << aaScorer_.gapOpenCost() << std::endl;
+      std::cerr << "open query: " << pos_.gapCosts.openQuery
+		<< " " << aaResult << std::endl;
 #endif
+
+      return pos_.gapCosts.openQuery + aaResult * pos_.aaWeight;
     }
 
-#ifdef TRACE
-    std::cerr << "open ref: " << ntResult << " " << aaResult << std::endl;
-#endif
+    int scoreExtendQueryGap(const NTSequence6AA& query, int queryI, int k) const
+    {
+      if (queryI == query.size() - 1 || queryI == -1)
+	return pos_.ntWeight
+	  * scorer_.ntScorer_.scoreExtendQueryGap(ref_, query, refI_, queryI, k);
+
+      return pos_.gapCosts.extendQuery[k % 3];
+    }
+
+  private:
+    GenomeScorer& scorer_;
+    const Genome& ref_;
+    const int refI_;
+    const GenomePosition& pos_;
+    const int *ntRow_;
+    const CdsPosition *cds_;
+    const int cdsCount_;
+    const bool refEnd_;
+  };
+
+  /*
+   * Calls f(column) with the Column for refI, specialized for the
+   * number of CDS positions at refI.
+   */
+  template <class F>
+  void forColumn(const Genome& ref, int refI, F& f)
+  {
+    switch (ref.position(refI).cdsCount) {
+    case 0:
+      f(Column<0>(*this, ref, refI));
+      break;
+    case 1:
+      f(Column<1>(*this, ref, refI));
+      break;
+    default:
+      f(Column<AnyCds>(*this, ref, refI));
+    }
+  }
+
+  int scoreExtend(const Genome& ref, const NTSequence6AA& query,
+		  unsigned refI, unsigned queryI)
+  {
+    return Column<AnyCds>(*this, ref, refI).scoreExtend(query, queryI);
+  }
+
+  int scoreOpenRefGap(const Genome& ref, const NTSequence6AA& query,
+		      int refI, int queryI)
+  {
+    if (refI == -1)
+      return
+	ref.ntWeight(0) * ntScorer_.scoreOpenRefGap(ref, query, refI, queryI);      
 
-    return ntResult * ref.ntWeight(refI) + aaResult * ref.aaWeight(refI);
+    return Column<AnyCds>(*this, ref, refI).scoreOpenRefGap(query, queryI);
   }
 
   /* k : old gap length mod 3 */
   int scoreExtendRefGap(const Genome& ref, const NTSequence6AA& query,
 			int refI, int queryI, int k)
   {
-    if (refI == ref.size() - 1)
-      return
-	ref.ntWeight(refI) * ntScorer_.scoreExtendRefGap(ref, query, refI, queryI, k);
-    else if (refI == -1)
+    if (refI == -1)
       return
 	ref.ntWeight(0) * ntScorer_.scoreExtendRefGap(ref, query, refI, queryI, k);      
 
-    int ntResult = ntScorer_.scoreExtendRefGap(ref, query, refI, queryI, k);
-
-    int aaResult = 0;
-    for (const auto& p : ref.cdsAa(refI)) {
-      if (k % 3 == 2) {
-	if (p.cdsRegionI != 0)
-	  aaResult -= aaScorer_.frameShiftCost();
-      } else if (k % 3 == 0) {
-	aaResult += aaScorer_.frameShiftCost();
-	aaResult += aaScorer_.gapExtendCost();
-      }
-    }
-
-#ifdef TRACE
-    std::cerr << "extend ref: " << ntResult << " " << aaResult << std::endl;
-#endif
-
-    return ntResult * ref.ntWeight(refI) + aaResult * ref.aaWeight(refI);
+    return Column<AnyCds>(*this, ref, refI).scoreExtendRefGap(query, queryI, k);
   }
 
   int scoreOpenQueryGap(const Genome& ref, const NTSequence6AA& query,
 			int refI, int queryI)
   {
     if (queryI == query.size() - 1 || queryI == -1)
-      return ref.ntWeight(refI) * ntScorer_.scoreOpenQueryGap(ref, query, refI, queryI);
-
-    int ntResult = ntScorer_.scoreOpenQueryGap(ref, query, refI, queryI);
-
-    int aaResult = 0;
-    if (refI > 0) {
-      for (const auto& p : ref.cdsAa(refI)) {
-	/* 
-	 * Penalize if we are starting a gap at a non-codon boundary.
-	 * This should score a gap at refI, hence position 0
-	 */
-#ifdef TRACE
-	std::cerr << "open aa query gap: ";
-#endif
-
-	if (p.i != 0 && (int)(queryI - p.i + 1) >= 0) {
-	  aaResult += aaScorer_.misalignmentCost();
-
-	  seq::AminoAcid aaRef = p.aa;
-	  seq::AminoAcid aaQuery = query.translate(queryI - p.i + 1, p.reverseComplement);
-	  aaResult -= aaScorer_.scoreExtend(aaRef, aaQuery);
-#ifdef TRACE
-	  std::cerr << aaScorer_.misalignmentCost() << " - " << aaRef << "," << aaQuery << ":" << aaScorer_.scoreExtend(aaRef, aaQuery);
-#endif
-	}
-
-	/*
-	 * More correctly, we should not score this for a gap that
-	 * starts at exactly the start of the CDS region, but then we
-	 * do not know when to not cancel the frameshift in extend()
-	 *
-	 * A workaround would be to consider the situation of refI-1
-	 * for query gaps (cfr ~#5bf1d) but that isn't correct either
-	 */
-	//if (p.cdsRegionI > 0 || p.i > 0) {	  
-	aaResult += aaScorer_.frameShiftCost();
-	aaResult += aaScorer_.gapOpenCost();
-	//}
+      return ref.ntWeight(std::max(0, refI)) * ntScorer_.scoreOpenQueryGap(ref, query, refI, queryI);
 
-#ifdef TRACE
-	std::cerr << " + " << aaScorer_.frameShiftCost() << " + " << aaScorer_.gapOpenCost() << std::endl;
-#endif
-      }
-    }
-
-#ifdef TRACE
-    std::cerr << "open query: " << ntResult << " " << aaResult << std::endl;
-#endif
-
-    return ntResult * ref.ntWeight(refI) + aaResult * ref.aaWeight(refI);
+    return Column<AnyCds>(*this, ref, refI).scoreOpenQueryGap(query, queryI);
   }
   
   int scoreExtendQueryGap(const Genome& ref, const NTSequence6AA& query,
 			  int refI, int queryI, int k)
   {
     if (queryI == query.size() - 1 || queryI == -1)
-      return ref.ntWeight(refI) * ntScorer_.scoreExtendQueryGap(ref, query, refI, queryI, k);
-
-    int ntResult = ntScorer_.scoreExtendQueryGap(ref, query, refI, queryI, k);
-
-    int aaResult = 0;
-    /* 
-     * Consider a gap extended after refI - 1
-     */
-    if (refI > 0) {
-      for (const auto& p : ref.cdsAa(refI)) {
-	if (p.cdsRegionI == 0 && p.i == 0) {
-	  if (k % 3 != 0) {
-	    aaResult += aaScorer_.frameShiftCost();
-	    aaResult += aaScorer_.misalignmentCost();
-	  }
-	}
+      return ref.ntWeight(std::max(0, refI)) * ntScorer_.scoreExtendQueryGap(ref, query, refI, queryI, k);
 
-	if (k % 3 == 2) {
-	  aaResult -= aaScorer_.frameShiftCost();
-	} else if (k % 3 == 0) {
-	  aaResult += aaScorer_.frameShiftCost();
-	  aaResult += aaScorer_.gapExtendCost();
-	}
-      }
-    }
-
-#ifdef TRACE
-    std::cerr << "extend query: " << ntResult << " " << aaResult << std::endl;
-#endif
-
-    return ntResult * ref.ntWeight(refI) + aaResult * ref.aaWeight(refI);
+    return Column<AnyCds>(*this, ref, refI).scoreExtendQueryGap(query, queryI, k);
   }
 
   double calcScore(const Genome& ref, const seq::NTSequence& query, int frameshifts) const {
@@ -288,9 +311,25 @@ public:
   }
   
 private:
+  /*
+   * The misalignment penalty for a gap opened within the codon of p,
+   * replacing the score of the query amino acid at queryI.
+   */
+  int misalignmentCorrection(const CdsPosition& p, const NTSequence6AA& query,
+			     int queryI) const
+  {
+    return aaScorer_.misalignmentCost()
+      - aaMatrix_[p.aa.intRep() * AaCount
+		  + query.aaRep(queryI, p.reverseComplement)];
+  }
+
+  /* Amino acids covered by a substitution matrix: A .. X */
+  static const int AaCount = seq::AminoAcid::AA_X + 1;
+
   SimpleScorer<seq::NTSequence> ntScorer_;
   SimpleScorer<seq::AASequence> aaScorer_;
   const int ntWeight_, aaWeight_;
+  std::vector<int> aaMatrix_; // the weight matrix of aaScorer_, by row
 };
 
 #endif // GENOME_SCORER_H_
@@ -9,18 +9,35 @@
 
 #include <limits>
 #include <iomanip>
+#include <type_traits>
+#include <algorithm>
+#include <memory>
+#include <atomic>
+#include <thread>
 
 #include "SubstitutionMatrix.h"
 #include "Cigar.h"
 #include "SearchRange.h"
 #include "SparseVector.h"
+#include "ColumnKernel.h"
+#include "EndGaps.h"
+#include "LinearSpaceAligner.h"
+#include "Wavefront.h"
+#include "StripeSize.h"
 
 template <class Scorer, class Reference, class Query, int SideN>
 class GlobalAligner
 {
 public:
   GlobalAligner(const Scorer& scorer)
-    : scorer_(scorer)
+    : scorer_(scorer),
+      linearSpace_(false),
+      threads_(1),
+      xDrop_(0),
+      bandWidenings_(0),
+      maxBandWidenings_(3),
+      memoryLimit_(1000UL*1000*1000),
+      stripeColumns_(0)
   { } 
 
   struct Solution {
@@ -33,403 +50,940 @@ public:
   Solution align(const Reference& seq1, const Query& seq2,
 		 SearchRange sr = SearchRange());
 
+  /*
+   * Computes only the score of the alignment, keeping two columns of
+   * scores and no traceback (in a single thread).
+   */
+  int scoreOnly(const Reference& seq1, const Query& seq2,
+		SearchRange sr = SearchRange());
+
+  /*
+   * Computes the optimal alignment that aligns each of the points
+   * (increasing in both sequences) as a match, solving the
+   * sub-alignments between the points independently, on threads()
+   * threads. A sub-alignment is computed like align() within the
+   * search range, but in a single thread, without X-drop and without
+   * widening the search range. Falls back to align() if a point is not
+   * within the search range.
+   */
+  Solution alignThrough(const Reference& seq1, const Query& seq2,
+			const SearchRange& sr,
+			const std::vector<SplitPoint>& points);
+
   Scorer& scorer() { return scorer_; }
+
+  /*
+   * Use a divide-and-conquer evaluation with memory linear in the
+   * sequence lengths instead of the stripes of the full matrix, at
+   * the cost of about twice the computation.
+   */
+  void setLinearSpace(bool enabled) { linearSpace_ = enabled; }
+  bool linearSpace() const { return linearSpace_; }
+
+  /*
+   * Compute the matrix using a number of threads, in tiles that are
+   * processed along anti-diagonals (only for SideN > 0).
+   */
+  void setThreads(int threads) { threads_ = std::max(1, threads); }
+  int threads() const { return threads_; }
+
+  /*
+   * Drops the cells of a column at the start and the end of its rows
+   * whose score is more than xDrop below the best score of the column
+   * (0 disables X-drop, which is the default). The rows of the next
+   * column are limited to the rows in reach of the remaining cells,
+   * and extended further down while the score remains within xDrop
+   * of the best score.
+   *
+   * This is a heuristic for similar sequences, which may miss the
+   * optimal alignment. When the end of the alignment is dropped, the
+   * alignment is recomputed without X-drop. X-drop is not used in
+   * linear space, and computes a column in a single thread.
+   */
+  void setXDrop(int xDrop) { xDrop_ = std::max(0, xDrop); }
+  int xDrop() const { return xDrop_; }
+
+  /*
+   * The number of times the search range is widened when the
+   * alignment comes near its border (default 3, 0 disables widening).
+   */
+  void setMaxBandWidenings(int n) { maxBandWidenings_ = std::max(0, n); }
+  int maxBandWidenings() const { return maxBandWidenings_; }
+
+  /*
+   * The number of columns by which the widenings may extend the part
+   * of the search range in which the alignment leaves its first and
+   * last row, before and after.
+   */
+  int maxWidenedColumns() const {
+    return 4 * BandWidening * ((1 << maxBandWidenings_) - 1);
+  }
+
+  /*
+   * Limits the memory used for the matrix (in bytes, default 1 GB),
+   * by choosing the number of columns of the stripes in which it is
+   * computed.
+   */
+  void setMemoryLimit(unsigned long bytes) { memoryLimit_ = bytes; }
+  unsigned long memoryLimit() const { return memoryLimit_; }
+
+  /*
+   * The number of columns of a stripe in the last alignment, or 0 if
+   * it was computed in linear space.
+   */
+  unsigned stripeColumns() const { return stripeColumns_; }
   
 private:
   Scorer scorer_;
+  bool linearSpace_;
+  int threads_, xDrop_, bandWidenings_, maxBandWidenings_;
+  unsigned long memoryLimit_;
+  unsigned stripeColumns_;
+
+  /* Tiles span at most TileColumns columns and at least TileRows rows */
+  static const int TileColumns = 256;
+  static const int TileRows = 1024;
+
+  /* Rows by which a column is extended at once with X-drop */
+  static const int XDropRows = 32;
+
+  /*
+   * Rows by which the search range is widened (doubling every time)
+   * when the alignment comes within BorderRows rows of its border.
+   * A gap in the kernel spans up to SideN rows at once, and thus an
+   * alignment that is cut by the border may stay a few rows away
+   * from it.
+   */
+  static const int BandWidening = 150;
+  static const int BorderRows = SideN + 4;
+
+  static const int INVALID_SCORE;
+
+  typedef ColumnKernel<SideN> Kernel;
+  typedef typename Kernel::TraceCell TraceCell;
+
+  /*
+   * Scores of a column, as a plane with all rows for each state (see
+   * ColumnKernel), and invalid scores outside the computed rows
+   * [start, end). The last op of D is only needed (and maintained)
+   * when SideN == 0, to score the gap extension.
+   */
+  struct Column {
+    Column(int aRows)
+      : rows(aRows),
+	start(0),
+	end(aRows),
+	scores(Kernel::StateCount * aRows, INVALID_SCORE),
+	op(SideN == 0 ? aRows : 0, CigarItem(CigarItem::Match))
+    { }
+
+    void resetRange(int aStart, int anEnd) {
+      invalidate(start, std::min(end, aStart));
+      invalidate(std::max(start, anEnd), end);
+      start = aStart;
+      end = anEnd;
+    }
+
+    int *plane(int state) { return &scores[state * rows]; }
+    const int *plane(int state) const { return &scores[state * rows]; }
+
+    int rows, start, end;
+    std::vector<int> scores;
+    std::vector<CigarItem> op;
+
+  private:
+    void invalidate(int from, int to) {
+      if (from >= to)
+	return;
+
+      for (int s = 0; s < Kernel::StateCount; ++s)
+	std::fill(plane(s) + from, plane(s) + to, INVALID_SCORE);
+
+      if (SideN == 0)
+	std::fill(op.begin() + from, op.begin() + to,
+		  CigarItem(CigarItem::Match));
+    }
+  };
+
+  typedef std::vector<sparse_vector<TraceCell>> Trace;
+
+  /*
+   * A stripe of columns, with the column before its first column
+   * from which it can be recomputed.
+   */
+  struct Stripe {
+    Stripe(unsigned aStart, unsigned aN, int aStartRow,
+	   const Column& aBoundary)
+      : start(aStart), n(aN), startRow(aStartRow), boundary(aBoundary)
+    { }
+
+    unsigned start, n;
+    int startRow;
+    Column boundary;
+  };
+
+  /*
+   * A block of rows [start, end) of the matrix in the tiled
+   * computation, with its columns which also hold row start - 1.
+   */
+  struct RowBlock {
+    RowBlock(int aStart, int anEnd)
+      : start(aStart), end(anEnd),
+	prev(anEnd - aStart + 1), cur(anEnd - aStart + 1),
+	kernel(anEnd - aStart + 1, aStart - 1)
+    { }
+
+    int start, end;
+    Column prev, cur;
+    Kernel kernel;
+  };
+
+  /*
+   * The part of the matrix from the cell (startColumn, startRow) to
+   * the cell (endColumn, endRow) in endState. Unless it starts at (0,
+   * 0), the first cell holds a match with score 0.
+   */
+  struct Span {
+    Span(int aStartColumn, int aStartRow,
+	 int anEndColumn, int anEndRow, int anEndState)
+      : startColumn(aStartColumn), startRow(aStartRow),
+	endColumn(anEndColumn), endRow(anEndRow), endState(anEndState)
+    { }
+
+    int startColumn, startRow, endColumn, endRow, endState;
+  };
+
+  Solution alignSpan(const Reference& ref, const Query& query,
+		     SearchRange& sr, const Span& span);
+
+  void initColumn(const Reference& ref, const Query& query,
+		  const SearchRange& sr, Column& column);
+  void startColumn(const Reference& ref, const Query& query, int i,
+		   int startRow, int endRow, const Column& prev, Column& cur);
+  int computeColumnXDrop(const Reference& ref, const Query& query, int i,
+			 int startRow, int endRow, int maxEndRow,
+			 const Column& prev, Column& cur, TraceCell *trace,
+			 Kernel& kernel);
+  void xDropRange(const Column& column, int& start, int& end) const;
+  int computeStripe(const Reference& ref, const Query& query,
+		    const SearchRange& sr, const Stripe& stripe,
+		    Column& column, Trace& trace);
+  int computeStripeTiled(const Reference& ref, const Query& query,
+			 const SearchRange& sr, const Stripe& stripe,
+			 Column& column, Trace& trace, std::true_type);
+  int computeStripeTiled(const Reference& ref, const Query& query,
+			 const SearchRange& sr, const Stripe& stripe,
+			 Column& column, Trace& trace, std::false_type);
+  void computeColumn(const Reference& ref, const Query& query, int i,
+		     int from, int to, const Column& prev, Column& cur,
+		     TraceCell *trace, Kernel& kernel, std::true_type);
+  void computeColumn(const Reference& ref, const Query& query, int i,
+		     int from, int to, const Column& prev, Column& cur,
+		     TraceCell *trace, Kernel& kernel, std::false_type);
+
+  Solution alignLinearSpace(const Reference& ref, const Query& query,
+			    const SearchRange& sr, std::true_type);
+  Solution alignLinearSpace(const Reference& ref, const Query& query,
+			    const SearchRange& sr, std::false_type);
 };
 
+template <class Scorer, class Reference, class Query, int SideN>
+const int GlobalAligner<Scorer, Reference, Query, SideN>::INVALID_SCORE
+  = Kernel::InvalidScore;
+
+template <class Scorer, class Reference, class Query, int SideN>
+typename GlobalAligner<Scorer, Reference, Query, SideN>::Solution
+GlobalAligner<Scorer, Reference, Query, SideN>
+::alignLinearSpace(const Reference& ref, const Query& query,
+		   const SearchRange& sr, std::true_type)
+{
+  Solution result;
+
+  LinearSpaceAligner<Scorer, Reference, Query, SideN>
+    aligner(scorer_, ref, query, sr);
+  result.score = aligner.align(result.cigar);
+
+  convertEndGaps(scorer_, result.cigar);
+
+  return result;
+}
+
+template <class Scorer, class Reference, class Query, int SideN>
+typename GlobalAligner<Scorer, Reference, Query, SideN>::Solution
+GlobalAligner<Scorer, Reference, Query, SideN>
+::alignLinearSpace(const Reference& ref, const Query& query,
+		   const SearchRange& sr, std::false_type)
+{
+  throw std::runtime_error("Linear space alignment requires SideN > 0");
+}
+
+template <class Scorer, class Reference, class Query, int SideN>
+typename GlobalAligner<Scorer, Reference, Query, SideN>::Solution
+GlobalAligner<Scorer, Reference, Query, SideN>
+::alignThrough(const Reference& ref, const Query& query,
+	       const SearchRange& sr, const std::vector<SplitPoint>& points)
+{
+  if (points.empty() || sr.empty())
+    return align(ref, query, sr);
+
+  /*
+   * The spans between consecutive points, each ending with the match
+   * of its point, and the last one with the end of the alignment
+   */
+  std::vector<Span> spans;
+  int column = 0, row = 0;
+  for (const auto& p : points) {
+    spans.push_back(Span(column, row, p.refPos + 1, p.queryPos + 1,
+			 Kernel::StateM));
+    column = p.refPos + 1;
+    row = p.queryPos + 1;
+  }
+  spans.push_back(Span(column, row, ref.size(), query.size(),
+		       Kernel::StateD));
+
+  const int n = spans.size();
+  std::vector<Solution> parts(n);
+  std::vector<unsigned> stripeColumns(n);
+
+  /*
+   * Each thread aligns spans with its own copy of the aligner, which
+   * shares the memory limit with the other threads
+   */
+  std::atomic<int> next(0);
+  auto work = [&]() {
+    GlobalAligner aligner(*this);
+    aligner.threads_ = 1;
+    aligner.xDrop_ = 0;
+    aligner.maxBandWidenings_ = 0;
+    aligner.memoryLimit_ = memoryLimit_ / std::min(threads_, n);
+
+    for (int i; (i = next++) < n;) {
+      const Span& span = spans[i];
+      SearchRange spanRange = sr;
+      spanRange.narrow(span.startColumn, span.startColumn + 1,
+		       span.startRow, span.startRow + 1);
+      spanRange.narrow(span.startColumn + 1, span.endColumn + 1,
+		       span.startRow, span.endRow + 1);
+      parts[i] = aligner.alignSpan(ref, query, spanRange, span);
+      stripeColumns[i] = aligner.stripeColumns_;
+    }
+  };
+
+  std::vector<std::thread> workers;
+  for (int t = 1; t < std::min(threads_, n); ++t)
+    workers.push_back(std::thread(work));
+  work();
+  for (auto& w : workers)
+    w.join();
+
+  Solution result;
+  for (int i = 0; i < n; ++i) {
+    if (parts[i].score <= INVALID_SCORE / 2)
+      return align(ref, query, sr);
+
+    result.score += parts[i].score;
+    for (const auto& item : parts[i].cigar) {
+      if (!result.cigar.empty() && result.cigar.back().op() == item.op())
+	result.cigar.back().add(item.length());
+      else
+	result.cigar.push_back(item);
+    }
+  }
+
+  convertEndGaps(scorer_, result.cigar);
+
+  stripeColumns_ = *std::max_element(stripeColumns.begin(),
+				     stripeColumns.end());
+
+  return result;
+}
+
 template <class Scorer, class Reference, class Query, int SideN>
 typename GlobalAligner<Scorer, Reference, Query, SideN>::Solution
 GlobalAligner<Scorer, Reference, Query, SideN>::align(const Reference& ref, const Query& query,
 						      SearchRange sr)
 {
-  sparse_vector<Solution> result(query.size() + 1);
-
-  if (sr.items.empty())
+  if (sr.empty())
     sr = SearchRange(ref.size() + 1, query.size() + 1);
 
-  result.resetRange(sr.startRow(0), sr.endRow(0));
+  if (linearSpace_) {
+    stripeColumns_ = 0;
+    return alignLinearSpace(ref, query, sr,
+			    std::integral_constant<bool, (SideN > 0)>());
+  }
+
+  Solution result
+    = alignSpan(ref, query, sr,
+		Span(0, 0, ref.size(), query.size(), Kernel::StateD));
 
-  for (unsigned hj = std::max(1, sr.startRow(0)); hj < sr.endRow(0); ++hj) {
-    unsigned j = hj - 1;
-    result[hj].cigar = result[hj - 1].cigar;
-    result[hj].cigar.addRefGap();
-    result[hj].score = result[hj - 1].score;
-    if (j == 0)
-      result[hj].score += scorer_.scoreOpenRefGap(ref, query, -1, 0);
+  convertEndGaps(scorer_, result.cigar);
+
+  return result;
+}
+
+template <class Scorer, class Reference, class Query, int SideN>
+typename GlobalAligner<Scorer, Reference, Query, SideN>::Solution
+GlobalAligner<Scorer, Reference, Query, SideN>
+::alignSpan(const Reference& ref, const Query& query,
+	    SearchRange& sr, const Span& span)
+{
+  Column column(query.size() + 1);
+  if (span.startColumn == 0)
+    initColumn(ref, query, sr, column);
+  else {
+    column.resetRange(span.startRow, span.startRow + 1);
+    column.plane(Kernel::StateD)[span.startRow]
+      = column.plane(Kernel::StateM)[span.startRow] = 0;
+  }
+
+  /*
+   * The matrix is computed in stripes of N columns, keeping only the
+   * traceback of each cell. Stripes pass on their last column, and
+   * the traceback recomputes earlier stripes from their boundary
+   * column. N is chosen so that the traceback of a stripe, the
+   * boundary columns, and the working columns (three, or five when
+   * tiled) with the kernel fit in the memory limit.
+   *
+   * With X-drop, the rows of a column follow from the scores of the
+   * previous column, and thus also when a stripe is recomputed.
+   *
+   * When the alignment passes near the first or the last row of the
+   * search range in a column, the optimal alignment may lie outside
+   * of it. The search range is then widened around each range of
+   * columns where this happened, and the alignment recomputed.
+   */
+  const unsigned long columnBytes = (query.size() + 1)
+    * (Kernel::StateCount * sizeof(int)
+       + (SideN == 0 ? sizeof(CigarItem) : 0));
+  const unsigned long kernelBytes = SideN == 0 ? 0 : (query.size() + 1)
+    * ((6 + 2 * SideN) * sizeof(int) + sizeof(TraceCell));
+
+  const unsigned N
+    = chooseStripeColumns(memoryLimit_, span.endColumn - span.startColumn,
+			  sr.maxRowCount() * sizeof(TraceCell)
+			  + sizeof(sparse_vector<TraceCell>),
+			  columnBytes + sizeof(Stripe),
+			  (threads_ > 1 ? 5 : 3) * columnBytes + kernelBytes);
+  stripeColumns_ = N;
+
+  Trace trace(N, sparse_vector<TraceCell>(query.size() + 1));
+  std::vector<Stripe> stripes;
+
+  int startRow = sr.startRow(span.startColumn);
+  unsigned stripeI = span.startColumn;
+  do {
+    unsigned n = std::min((unsigned)(span.endColumn - stripeI), N);
+    stripes.push_back(Stripe(stripeI, n, startRow, column));
+    startRow = computeStripe(ref, query, sr, stripes.back(), column, trace);
+    stripeI += n;
+  } while ((int)stripeI < span.endColumn);
+
+  if (xDrop_ > 0
+      && column.plane(span.endState)[span.endRow] <= INVALID_SCORE / 2) {
+    const int xDrop = xDrop_;
+    xDrop_ = 0;
+    Solution result = alignSpan(ref, query, sr, span);
+    xDrop_ = xDrop;
+    return result;
+  }
+
+  Solution result;
+  result.score = column.plane(span.endState)[span.endRow];
+
+  /* Trace back from the end and construct cigar -- reverse in the end */
+  Cigar rCigar;
+
+  int s = stripes.size() - 1;
+  int hi = span.endColumn;
+  int hj = span.endRow;
+  int state = span.endState;
+
+  const int rows = query.size() + 1;
+  const int margin = BandWidening << bandWidenings_;
+  const int reach = 4 * margin;
+
+  /*
+   * The column ranges [first, second) near the border, from the end.
+   * A range is widened by margin rows, together with reach columns
+   * before and after it, and ranges that would overlap are merged.
+   */
+  std::vector<std::pair<int, int>> borders;
+
+  while (hi > span.startColumn || hj > span.startRow) {
+    CigarItem::Op op;
+
+    if (hi == 0) {
+      op = CigarItem::RefGap;
+      --hj;
+    } else if (hj == 0) {
+      op = CigarItem::QueryGap;
+      --hi;
+    } else {
+      while (hi <= (int)stripes[s].start) {
+	--s;
+	computeStripe(ref, query, sr, stripes[s], column, trace);
+      }
+
+      const sparse_vector<TraceCell>& tr = trace[hi - 1 - stripes[s].start];
+
+      /*
+       * The path may continue to the next column only from its first
+       * row down, and come from the previous column only up to its
+       * last row. Like the first row, the last row only skips the
+       * reference, in the columns before and after the query.
+       */
+      const int start = hi < span.endColumn
+	? std::max(tr.start(), sr.startRow(hi + 1)) : tr.start();
+      const int end = std::min(tr.end(), sr.endRow(hi - 1));
+      if (hj < rows - 1
+	  && ((start > 0 && hj - start < BorderRows)
+	      || (end < rows && end - 1 - hj < BorderRows))) {
+	if (!borders.empty() && borders.back().first - hi <= 2 * reach)
+	  borders.back().first = std::min(borders.back().first, hi);
+	else
+	  borders.push_back(std::make_pair(hi, hi + 1));
+      }
+
+      op = Kernel::traceBack(tr.at(hj), state, hi, hj);
+    }
+
+    if (rCigar.size() > 0 && rCigar.back().op() == op)
+      rCigar.back().add();
     else
-      result[hj].score += scorer_.scoreExtendRefGap(ref, query, -1, j, j);
+      rCigar.push_back(CigarItem(op));
   }
 
-  result[0].cigar.push_back(CigarItem(CigarItem::QueryGap, 0));
+  if (!borders.empty() && xDrop_ == 0) {
+    if (bandWidenings_ < maxBandWidenings_) {
+      for (const auto& b : borders)
+	sr.widen(b.first - reach, b.second + reach, margin);
 
-  static const int INVALID_SCORE = std::numeric_limits<int>::min() / 2;
+      ++bandWidenings_;
+      result = alignSpan(ref, query, sr, span);
+      --bandWidenings_;
 
-  struct ArrayItem {
-    ArrayItem()
-      : op(CigarItem::Match),
-	score(INVALID_SCORE)
-    { }
+      return result;
+    } else if (maxBandWidenings_ > 0)
+      std::cerr << "Alignment still near the border of the search range "
+		<< "after widening it " << maxBandWidenings_ << " times"
+		<< std::endl;
+  }
 
-    CigarItem op;
-    int score;
-  };
+  result.cigar.insert(result.cigar.end(), rCigar.rbegin(), rCigar.rend());
 
-  struct ArrayItems {
-    ArrayItem D, M;
-    ArrayItem P[SideN]; // ending with k = 3n + SideN + 1 gaps in ref
-    ArrayItem Q[SideN]; // ending with gaps in query
-  };
+  return result;
+}
 
-  const unsigned N = std::min((int)ref.size(), 10000*1000 / sr.maxRowCount());
+template <class Scorer, class Reference, class Query, int SideN>
+void GlobalAligner<Scorer, Reference, Query, SideN>
+::initColumn(const Reference& ref, const Query& query,
+	     const SearchRange& sr, Column& column)
+{
+  column.resetRange(sr.startRow(0), sr.endRow(0));
+
+  int *D = column.plane(Kernel::StateD);
+  int *M = column.plane(Kernel::StateM);
+
+  int score = 0;
+  for (unsigned hj = sr.startRow(0); hj < sr.endRow(0); ++hj) {
+    if (hj > 0) {
+      unsigned j = hj - 1;
+      if (j == 0)
+	score += scorer_.scoreOpenRefGap(ref, query, -1, 0);
+      else
+	score += scorer_.scoreExtendRefGap(ref, query, -1, j, j);
+    }
 
-  std::vector<sparse_vector<ArrayItems>> work(N + 1, sparse_vector<ArrayItems>(query.size() + 1));
+    D[hj] = M[hj] = score;
+    if (SideN == 0)
+      column.op[hj] = CigarItem(CigarItem::RefGap, hj);
+  }
 
-//#define TRACE
-#ifdef TRACE
-  static const int traceI = 6, traceJ = 5;
-#endif
+  score = scorer_.scoreOpenQueryGap(ref, query, -1, -1);
+  D[0] = M[0] = score;
+  if (SideN == 0)
+    column.op[0] = CigarItem(CigarItem::QueryGap, 0);
+}
 
-  int startRow = 0;
-  
-  for (unsigned stripeI = 0; stripeI < ref.size(); stripeI += N) {
-    unsigned n = std::min((unsigned)(ref.size() - stripeI), N);
-
-    if (stripeI == 0) {
-      startRow = sr.startRow(0);
-      work[0].resetRange(startRow, sr.endRow(0));
-
-      for (unsigned hj = startRow; hj < sr.endRow(0); ++hj) {
-	work[0][hj].D.score = result[hj].score;
-	work[0][hj].D.op = result[hj].cigar.back();
-	work[0][hj].M = work[0][hj].D;
-
-	for (unsigned k = 0; k < SideN; ++k) {
-	  work[0][hj].P[k].score = INVALID_SCORE;
-	  work[0][hj].P[k].op = CigarItem(CigarItem::RefGap, 0); 
-	  work[0][hj].Q[k].score = INVALID_SCORE;
-	  work[0][hj].Q[k].op = CigarItem(CigarItem::QueryGap, 0);
-	}
-      }
+/*
+ * Sets the rows [startRow, endRow) of column i, and computes its
+ * first row from the previous column if included.
+ */
+template <class Scorer, class Reference, class Query, int SideN>
+void GlobalAligner<Scorer, Reference, Query, SideN>
+::startColumn(const Reference& ref, const Query& query, int i,
+	      int startRow, int endRow, const Column& prev, Column& cur)
+{
+  cur.resetRange(startRow, endRow);
+
+  if (startRow == 0) {
+    int score = prev.plane(Kernel::StateD)[0]
+      + scorer_.scoreExtendQueryGap(ref, query, i, -1, i);
+    cur.plane(Kernel::StateD)[0] = cur.plane(Kernel::StateM)[0] = score;
+
+    if (SideN == 0) {
+      cur.op[0] = prev.op[0];
+      cur.op[0].add();
+    }
+  }
+}
+
+/*
+ * Computes column i with X-drop for the rows [startRow, endRow), and
+ * then further down, up to maxEndRow, while the last row is within
+ * xDrop_ of the best score of the column. The traceback of row hj is
+ * written to trace[hj]. Returns the end of the computed rows.
+ */
+template <class Scorer, class Reference, class Query, int SideN>
+int GlobalAligner<Scorer, Reference, Query, SideN>
+::computeColumnXDrop(const Reference& ref, const Query& query, int i,
+		     int startRow, int endRow, int maxEndRow,
+		     const Column& prev, Column& cur, TraceCell *trace,
+		     Kernel& kernel)
+{
+  endRow = std::max(startRow, endRow);
+  startColumn(ref, query, i, startRow, endRow, prev, cur);
+
+  const int *D = cur.plane(Kernel::StateD);
+  int best = INVALID_SCORE;
+
+  int scanned = startRow;
+  int from = std::max(1, startRow);
+  int to = endRow;
+  for (;;) {
+    if (from < to)
+      computeColumn(ref, query, i, from, to, prev, cur, &trace[from],
+		    kernel, std::integral_constant<bool, (SideN > 0)>());
+
+    for (; scanned < to; ++scanned)
+      best = std::max(best, D[scanned]);
+
+    if (to == maxEndRow || to == startRow || D[to - 1] < best - xDrop_)
+      return to;
 
-      work[0][0].D.op = CigarItem(CigarItem::QueryGap, 0);
-      work[0][0].D.score = scorer_.scoreOpenQueryGap(ref, query, -1, -1);
-      work[0][0].M = work[0][0].D;
+    from = to;
+    to = std::min(maxEndRow, to + XDropRows);
+    cur.resetRange(startRow, to);
+  }
+}
+
+/*
+ * The rows [start, end) of the column, without the rows at the start
+ * and the end with a score more than xDrop_ below the best score.
+ */
+template <class Scorer, class Reference, class Query, int SideN>
+void GlobalAligner<Scorer, Reference, Query, SideN>
+::xDropRange(const Column& column, int& start, int& end) const
+{
+  const int *D = column.plane(Kernel::StateD);
+
+  int best = INVALID_SCORE;
+  for (int hj = column.start; hj < column.end; ++hj)
+    best = std::max(best, D[hj]);
+
+  start = column.start;
+  while (start < column.end && D[start] < best - xDrop_)
+    ++start;
+
+  end = column.end;
+  while (end > start && D[end - 1] < best - xDrop_)
+    --end;
+}
+
+template <class Scorer, class Reference, class Query, int SideN>
+int GlobalAligner<Scorer, Reference, Query, SideN>
+::scoreOnly(const Reference& ref, const Query& query, SearchRange sr)
+{
+  if (sr.empty())
+    sr = SearchRange(ref.size() + 1, query.size() + 1);
+
+  Column prev(query.size() + 1), cur(query.size() + 1);
+  initColumn(ref, query, sr, prev);
+
+  /* The traceback of the current column, which is not kept */
+  std::vector<TraceCell> trace(query.size() + 1);
+  Kernel kernel(SideN > 0 ? query.size() + 1 : 0);
+
+  int startRow = sr.startRow(0);
+  int liveStart = 0, liveEnd = 0;
+  if (xDrop_ > 0)
+    xDropRange(prev, liveStart, liveEnd);
+
+  for (unsigned i = 0; i < ref.size(); ++i) {
+    startRow = std::max(startRow, sr.startRow(i + 1));
+    const int endRow = sr.endRow(i + 1);
+
+    if (xDrop_ > 0) {
+      startRow = std::max(startRow, liveStart);
+      computeColumnXDrop(ref, query, i, startRow,
+			 std::min(endRow, liveEnd + 1), endRow,
+			 prev, cur, &trace[0], kernel);
+      xDropRange(cur, liveStart, liveEnd);
     } else {
-      work[0] = work[N];
+      startColumn(ref, query, i, startRow, endRow, prev, cur);
+
+      const int from = std::max(1, startRow);
+      if (from < endRow)
+	computeColumn(ref, query, i, from, endRow, prev, cur, &trace[from],
+		      kernel, std::integral_constant<bool, (SideN > 0)>());
     }
 
-    for (unsigned i = stripeI; i < stripeI + n; ++i) {
-      unsigned hi = i - stripeI + 1;
+    std::swap(prev, cur);
+  }
 
-      startRow = std::max(startRow, sr.startRow(i + 1));
-      
-      work[hi].resetRange(startRow, sr.endRow(i + 1));
+  const int score = prev.plane(Kernel::StateD)[query.size()];
 
-      if (startRow == 0) {
-	work[hi][0] = work[hi - 1][0];
-	work[hi][0].D.op.add();
-	work[hi][0].D.score += scorer_.scoreExtendQueryGap(ref, query, i, -1, i);
-	work[hi][0].M = work[hi][0].D;
+  if (xDrop_ > 0 && score <= INVALID_SCORE / 2) {
+    const int xDrop = xDrop_;
+    xDrop_ = 0;
+    const int result = scoreOnly(ref, query, sr);
+    xDrop_ = xDrop;
+    return result;
+  }
 
-	for (unsigned k = 0; k < SideN; ++k)
-	  work[hi][0].Q[k].op.add();
-      }
+  return score;
+}
 
-      for (unsigned hj = std::max(1, startRow); hj < sr.endRow(i + 1); ++hj) {
-	unsigned j = hj - 1;
-
-#ifdef TRACE
-	if (i == traceI && j == traceJ) {
-	  std::cerr << (traceI + 1) << ", " << (traceJ + 1) << ": " << std::endl;
-	  std::cerr << "Delta-d: " << work[hi - 1][hj - 1].D.score << " + "
-		    << scorer_.scoreExtend(ref, query, i, j) << std::endl;
-	}
-#endif
-	int sextend = work[hi - 1].at(hj - 1).D.score + scorer_.scoreExtend(ref, query, i, j);
-	if (SideN > 0) {
-	  work[hi][hj].M.score = sextend;
-	  work[hi][hj].M.op = extend(work[hi - 1].at(hj - 1).D.op, CigarItem::Match);
-	}
-
-	int shgap = std::numeric_limits<int>::min();
-	CigarItem hgapLastOp(CigarItem::Match);
-	if (SideN == 0) {
-	  hgapLastOp = work[hi - 1].at(hj).D.op;
-	  if (hgapLastOp.op() == CigarItem::Match)
-	    shgap = work[hi - 1].at(hj).D.score + scorer_.scoreOpenQueryGap(ref, query, i, j);
-	  else if (hgapLastOp.op() == CigarItem::QueryGap)
-	    shgap = work[hi - 1].at(hj).D.score
-	      + scorer_.scoreExtendQueryGap(ref, query, i, j, hgapLastOp.length());
-	} else {
-#ifdef TRACE
-	  if (i == traceI && j == traceJ)
-	    std::cerr << "Delta-q(1): " << work[hi - 1][hj].M.score << " + " << scorer_.scoreOpenQueryGap(ref, query, i, j)
-		      << std::endl;
-#endif
-	  int shopengap = work[hi - 1].at(hj).M.score + scorer_.scoreOpenQueryGap(ref, query, i, j);
-	  shgap = shopengap;
-	  hgapLastOp = work[hi - 1].at(hj).M.op;
-	  for (int k = 0; k < SideN; ++k) {
-	    int kN = (k + 1) % SideN;
-	    int sK = work[hi - 1].at(hj).Q[k].score + scorer_.scoreExtendQueryGap(ref, query, i, j, kN);
-#ifdef TRACE
-	    if (i == traceI && j == traceJ)
-	      std::cerr << "Delta-q(" << k + 2 << "): " << work[hi - 1][hj].Q[k].score << " + "
-			<< scorer_.scoreExtendQueryGap(ref, query, i, j, kN) << std::endl;
-#endif
-	    if (k == SideN - 1 && shopengap > sK) {
-	      work[hi][hj].Q[0].score = shopengap;
-	      work[hi][hj].Q[0].op = extend(work[hi - 1].at(hj).M.op, CigarItem::QueryGap);
-	    } else {
-	      work[hi][hj].Q[kN].score = sK;
-	      /*
-		if (work[hi - 1][hj].Q[k].op.op() != CigarItem::QueryGap) {
-		  std::cerr << "Oops Q " << k << " " << hi - 1 << ", " << hj << std::endl;
-		}
-	      */
-	      work[hi][hj].Q[kN].op = extend(work[hi - 1].at(hj).Q[k].op, CigarItem::QueryGap);
-
-	      if (sK > shgap) {
-		shgap = sK;
-		hgapLastOp = work[hi - 1].at(hj).Q[k].op;
-	      }
-	    }
-	  }
-	}
-
-	int svgap = std::numeric_limits<int>::min();
-	CigarItem vgapLastOp(CigarItem::Match);
-	if (SideN == 0) {
-	  vgapLastOp = work[hi].at(hj - 1).D.op;
-	  if (vgapLastOp.op() == CigarItem::Match)
-	    svgap = work[hi].at(hj - 1).D.score + scorer_.scoreOpenRefGap(ref, query, i, j);
-	  else if (vgapLastOp.op() == CigarItem::RefGap)
-	    svgap = work[hi].at(hj - 1).D.score
-	      + scorer_.scoreExtendRefGap(ref, query, i, j, vgapLastOp.length());
-	} else {
-	  int svopengap = work[hi].at(hj - 1).M.score + scorer_.scoreOpenRefGap(ref, query, i, j);
-#ifdef TRACE
-	  if (i == traceI && j == traceJ)
-	    std::cerr << "Delta-p(1): " << work[hi][hj - 1].M.score << " + " << scorer_.scoreOpenRefGap(ref, query, i, j) << std::endl;
-#endif
-	  svgap = svopengap;
-	  vgapLastOp = work[hi].at(hj - 1).M.op;
-	  for (int k = 0; k < SideN; ++k) {
-	    int kN = (k + 1) % SideN;
-	    int sK = work[hi].at(hj - 1).P[k].score + scorer_.scoreExtendRefGap(ref, query, i, j, kN);
-
-#ifdef TRACE
-	    if (i == traceI && j == traceJ)
-	      std::cerr << "Delta-p(" << k + 2 << "): " << work[hi][hj - 1].P[k].score << " + " << scorer_.scoreExtendRefGap(ref, query, i, j, kN) << std::endl;
-#endif
-
-	    if (k == SideN - 1 && svopengap > sK) {
-	      work[hi][hj].P[0].score = svopengap;
-	      work[hi][hj].P[0].op = extend(work[hi].at(hj - 1).M.op, CigarItem::RefGap);
-	    } else {
-	      work[hi][hj].P[kN].score = sK;
-	      /*
-		if (work[hi][hj - 1].P[k].op.op() != CigarItem::RefGap) {
-		std::cerr << "Oops P " << k << " " << hi << ", " << hj - 1 << std::endl;
-		}
-	      */
-	      work[hi][hj].P[kN].op = extend(work[hi].at(hj - 1).P[k].op, CigarItem::RefGap);
-
-	      if (sK > svgap) {
-		svgap = sK;
-		vgapLastOp = work[hi].at(hj - 1).P[k].op;
-	      }
-	    }
-	  }
-	}
-
-	CigarItem::Op op;
-	CigarItem last(CigarItem::Match);
-
-	if (sextend > shgap && sextend > svgap) {
-	  work[hi][hj].D.score = sextend;
-	  op = CigarItem::Match;
-	  last = work[hi - 1].at(hj - 1).D.op;
-	  // std::cerr << "E ";
-	} else if (shgap > svgap) {	  
-	  work[hi][hj].D.score = shgap;
-	  op = CigarItem::QueryGap;
-	  last = hgapLastOp;
-	  // std::cerr << "D ";
-	} else {
-	  work[hi][hj].D.score = svgap;
-	  op = CigarItem::RefGap;
-	  last = vgapLastOp;
-	  // std::cerr << "I ";
-	}
-
-	work[hi][hj].D.op = extend(last, op);
-      }
+template <class Scorer, class Reference, class Query, int SideN>
+int GlobalAligner<Scorer, Reference, Query, SideN>
+::computeStripe(const Reference& ref, const Query& query,
+		const SearchRange& sr, const Stripe& stripe,
+		Column& column, Trace& trace)
+{
+  if (threads_ > 1 && SideN > 0 && query.size() > 0 && xDrop_ == 0)
+    return computeStripeTiled(ref, query, sr, stripe, column, trace,
+			      std::integral_constant<bool, (SideN > 0)>());
+
+  Column prev = stripe.boundary;
+  Column cur(query.size() + 1);
+  Kernel kernel(SideN > 0 ? query.size() + 1 : 0);
+
+  int startRow = stripe.startRow;
+
+  /*
+   * With X-drop, the traceback of a column is first computed in
+   * xDropTrace, since its rows are only known afterwards.
+   */
+  std::vector<TraceCell> xDropTrace(xDrop_ > 0 ? query.size() + 1 : 0);
+  int liveStart = 0, liveEnd = 0;
+  if (xDrop_ > 0)
+    xDropRange(prev, liveStart, liveEnd);
+
+  for (unsigned i = stripe.start; i < stripe.start + stripe.n; ++i) {
+    sparse_vector<TraceCell>& tr = trace[i - stripe.start];
+
+    startRow = std::max(startRow, sr.startRow(i + 1));
+    const int endRow = sr.endRow(i + 1);
+
+    if (xDrop_ > 0) {
+      startRow = std::max(startRow, liveStart);
+      const int end
+	= computeColumnXDrop(ref, query, i, startRow,
+			     std::min(endRow, liveEnd + 1), endRow,
+			     prev, cur, &xDropTrace[0], kernel);
+
+      tr.resetRange(startRow, end);
+      for (int hj = std::max(1, startRow); hj < end; ++hj)
+	tr[hj] = xDropTrace[hj];
+
+      xDropRange(cur, liveStart, liveEnd);
+    } else {
+      tr.resetRange(startRow, endRow);
+      startColumn(ref, query, i, startRow, endRow, prev, cur);
+
+      const int from = std::max(1, startRow);
+      if (from < endRow)
+	computeColumn(ref, query, i, from, endRow, prev, cur, &tr[from],
+		      kernel, std::integral_constant<bool, (SideN > 0)>());
     }
 
-    // Extend solution
-    const int i = n - 1;
+    std::swap(prev, cur);
+  }
 
-    sparse_vector<Solution> new_result(query.size() + 1);
-    new_result.resetRange(sr.startRow(stripeI + n), sr.endRow(stripeI + n));
+  std::swap(column, prev);
 
-    for (int rhj = sr.endRow(stripeI + n) - 1; rhj >= sr.startRow(stripeI + n); --rhj) {
-      if (rhj == 0) {
-	new_result[0] = result[0];
-	new_result[0].cigar.back().add(n);
+  return startRow;
+}
 
-	continue;
-      }
+template <class Scorer, class Reference, class Query, int SideN>
+int GlobalAligner<Scorer, Reference, Query, SideN>
+::computeStripeTiled(const Reference& ref, const Query& query,
+		     const SearchRange& sr, const Stripe& stripe,
+		     Column& column, Trace& trace, std::true_type)
+{
+  const int rows = query.size() + 1;
+
+  /*
+   * The row range of each column follows from the search range as in
+   * computeStripe(), and is needed up front by all row blocks.
+   */
+  std::vector<std::pair<int, int>> ranges(stripe.n);
+
+  int startRow = stripe.startRow;
+  for (unsigned c = 0; c < stripe.n; ++c) {
+    startRow = std::max(startRow, sr.startRow(stripe.start + c + 1));
+    ranges[c] = std::make_pair(startRow, sr.endRow(stripe.start + c + 1));
+    trace[c].resetRange(ranges[c].first, ranges[c].second);
+  }
+
+  /*
+   * Rows 1 .. rows - 1 are split in blocks, each of which computes
+   * the stripe in bands of TileColumns columns. A tile (band, block)
+   * passes the last row of each of its columns on to the tile of the
+   * next block, which uses it as the row before its first row.
+   */
+  const int blockRows
+    = std::max((int)TileRows, (rows - 1 + 2 * threads_ - 1) / (2 * threads_));
+
+  std::vector<std::unique_ptr<RowBlock>> blocks;
+  for (int r = 1; r < rows; r += blockRows) {
+    blocks.push_back(std::unique_ptr<RowBlock>
+		     (new RowBlock(r, std::min(rows, r + blockRows))));
+    RowBlock& block = *blocks.back();
+    for (int s = 0; s < Kernel::StateCount; ++s)
+      std::copy(stripe.boundary.plane(s) + block.start - 1,
+		stripe.boundary.plane(s) + block.end, block.prev.plane(s));
+  }
 
-      /* Trace back to start and construct cigar -- reverse in the end and append */
-      Cigar rCigar;
-
-      int j = rhj - 1;
-
-      int hi = i + 1;
-      int hj = j + 1;
-
-      ArrayItem *ai = &work[hi][hj].D;
-      int score = ai->score;
-
-      for (;;) {
-	rCigar.push_back(ai->op);
-	switch (ai->op.op()) {
-	case CigarItem::Match:
-	  hi -= ai->op.length();
-	  hj -= ai->op.length();
-	  break;
-	case CigarItem::QueryGap:
-	  hi -= ai->op.length();
-	  break;
-	case CigarItem::RefGap:
-	  hj -= ai->op.length();
-	}
-
-	if (hi <= 0) {
-	  /*
-	   * Since we intialize work[0][..] from last solution, we may be going too far
-	   */
-	  int tooFar = 0 - hi;
-	  rCigar.back().add(-tooFar);
-	  if (ai->op.op() == CigarItem::Match)
-	    hj += tooFar;
-
-	  break;
-	}
-
-	if (SideN > 0) {
-	  switch (ai->op.op()) {
-	  case CigarItem::Match:
-	    ai = &work[hi][hj].D;
-	    break;
-	  case CigarItem::QueryGap:
-	  case CigarItem::RefGap:
-	    ai = &work[hi][hj].M;
-	  }
+  const int bands = (stripe.n + TileColumns - 1) / TileColumns;
+  std::vector<std::vector<std::vector<int>>>
+    edges(blocks.size(), std::vector<std::vector<int>>(bands));
+
+  auto tile = [&](int a, int b) {
+    RowBlock& block = *blocks[b];
+    const int first = block.start - 1; // matrix row of the block's row 0
+    const int h = block.end - first;
+
+    const unsigned c0 = a * TileColumns;
+    const unsigned c1 = std::min(stripe.n, c0 + TileColumns);
+
+    std::vector<int> *in = b > 0 ? &edges[b - 1][a] : nullptr;
+    std::vector<int> *out
+      = b + 1 < (int)blocks.size() ? &edges[b][a] : nullptr;
+    if (out)
+      out->resize((c1 - c0) * Kernel::StateCount);
+
+    for (unsigned c = c0; c < c1; ++c) {
+      const int i = stripe.start + c;
+      const int from = std::min(h, std::max(0, ranges[c].first - first));
+      const int to = std::max(from, std::min(h, ranges[c].second - first));
+
+      block.cur.resetRange(from, to);
+
+      if (from == 0) {
+	if (b == 0) {
+	  int score = block.prev.plane(Kernel::StateD)[0]
+	    + scorer_.scoreExtendQueryGap(ref, query, i, -1, i);
+	  block.cur.plane(Kernel::StateD)[0]
+	    = block.cur.plane(Kernel::StateM)[0] = score;
 	} else
-	  ai = &work[hi][hj].D;
+	  for (int s = 0; s < Kernel::StateCount; ++s)
+	    block.cur.plane(s)[0] = (*in)[(c - c0) * Kernel::StateCount + s];
       }
 
-      /* Combine with solution for hj */
-      auto& nr = new_result[j + 1];
-      nr = result[hj];
-      nr.score = score;
-      if (nr.cigar.empty() || rCigar.back().op() != nr.cigar.back().op()) {
-	nr.cigar.insert(nr.cigar.end(), rCigar.rbegin(), rCigar.rend());
-      } else {
-	nr.cigar.back().add(rCigar.back().length());
-	nr.cigar.insert(nr.cigar.end(), rCigar.rbegin() + 1, rCigar.rend());
-      }
+      const int f = std::max(1, from);
+      if (f < to)
+	computeColumn(ref, query, i, f, to, block.prev, block.cur,
+		      &trace[c][first + f], block.kernel, std::true_type());
+
+      if (out)
+	for (int s = 0; s < Kernel::StateCount; ++s)
+	  (*out)[(c - c0) * Kernel::StateCount + s] = block.cur.plane(s)[h - 1];
 
-      if (i == ref.size() - 1)
-	break;
+      std::swap(block.prev, block.cur);
     }
 
-    std::swap(result, new_result);
+    if (in)
+      std::vector<int>().swap(*in);
+  };
+
+  Wavefront wavefront(bands, blocks.size());
+  wavefront.run(threads_, tile);
+
+  Column result(rows);
+  for (int s = 0; s < Kernel::StateCount; ++s) {
+    result.plane(s)[0] = blocks[0]->prev.plane(s)[0];
+    for (auto& block : blocks)
+      std::copy(block->prev.plane(s) + 1,
+		block->prev.plane(s) + block->end - block->start + 1,
+		result.plane(s) + block->start);
   }
+  result.start = ranges.back().first;
+  result.end = ranges.back().second;
+
+  std::swap(column, result);
+
+  return startRow;
+}
 
-#ifdef TRACE
-  auto write = [](std::ostream& o, const ArrayItem& item) {
-    if (item.score <= INVALID_SCORE / 2) {
-      o << "        ";
+template <class Scorer, class Reference, class Query, int SideN>
+int GlobalAligner<Scorer, Reference, Query, SideN>
+::computeStripeTiled(const Reference& ref, const Query& query,
+		     const SearchRange& sr, const Stripe& stripe,
+		     Column& column, Trace& trace, std::false_type)
+{
+  throw std::runtime_error("Tiled alignment requires SideN > 0");
+}
+
+template <class Scorer, class Reference, class Query, int SideN>
+void GlobalAligner<Scorer, Reference, Query, SideN>
+::computeColumn(const Reference& ref, const Query& query, int i,
+		int from, int to, const Column& prev, Column& cur,
+		TraceCell *trace, Kernel& kernel, std::true_type)
+{
+  const Query *queries = &query;
+  kernel.setCosts(scorer_, ref, &queries, i, from, to);
+  kernel.run(from, to, prev.plane(0), cur.plane(0), trace);
+}
+
+template <class Scorer, class Reference, class Query, int SideN>
+void GlobalAligner<Scorer, Reference, Query, SideN>
+::computeColumn(const Reference& ref, const Query& query, int i,
+		int from, int to, const Column& prev, Column& cur,
+		TraceCell *trace, Kernel& kernel, std::false_type)
+{
+  /*
+   * Without gap states, a gap is extended from D, scored using the
+   * length of the gap so far.
+   */
+  const int *prevD = prev.plane(Kernel::StateD);
+  int *D = cur.plane(Kernel::StateD);
+
+  for (int hj = from; hj < to; ++hj) {
+    int j = hj - 1;
+
+    int sextend = prevD[hj - 1] + scorer_.scoreExtend(ref, query, i, j);
+
+    int shgap = std::numeric_limits<int>::min();
+    const CigarItem& left = prev.op[hj];
+    if (left.op() == CigarItem::Match)
+      shgap = prevD[hj] + scorer_.scoreOpenQueryGap(ref, query, i, j);
+    else if (left.op() == CigarItem::QueryGap)
+      shgap = prevD[hj]
+	+ scorer_.scoreExtendQueryGap(ref, query, i, j, left.length());
+
+    int svgap = std::numeric_limits<int>::min();
+    const CigarItem& up = cur.op[hj - 1];
+    if (up.op() == CigarItem::Match)
+      svgap = D[hj - 1] + scorer_.scoreOpenRefGap(ref, query, i, j);
+    else if (up.op() == CigarItem::RefGap)
+      svgap = D[hj - 1]
+	+ scorer_.scoreExtendRefGap(ref, query, i, j, up.length());
+
+    if (sextend > shgap && sextend > svgap) {
+      D[hj] = sextend;
+      cur.op[hj] = extend(prev.op[hj - 1], CigarItem::Match);
+      trace[hj - from] = Kernel::FromMatch;
+    } else if (shgap > svgap) {
+      D[hj] = shgap;
+      cur.op[hj] = extend(left, CigarItem::QueryGap);
+      trace[hj - from] = Kernel::FromQueryGapOpen;
     } else {
-      o << std::setw(4) << item.score << ":" << item.op << " ";
-    }
-  };
-  
-  for (int j = 0; j < query.size() + 1; ++j) {
-    for (unsigned l = 0; l < 5; ++l) {
-      for (int i = 0; i < N + 1; ++i) {
-	auto& w = work[i][j];
-
-	/* M P P P | 
-	 * Q    (i)|
-	 * Q       |
-	 * Q (j) D |
-	 * ---------
-	 */
-	switch (l) {
-	case 0:
-	  write(std::cout, w.M);
-	  write(std::cout, w.P[0]);
-	  write(std::cout, w.P[1]);
-	  write(std::cout, w.P[2]);
-	  std::cout << "|";
-	  break;
-	case 1:
-	  write(std::cout, w.Q[0]);
-	  std::cout << "        "
-		    << "        "
-		    << "  (" << std::setw(4) << i << ")"
-		    << "|";
-	  break;
-	case 2:
-	  write(std::cout, w.Q[1]);
-	  std::cout << "        "
-		    << "        "
-		    << "        "
-		    << "|";
-	  break;
-	case 3:
-	  write(std::cout, w.Q[2]);
-	  std::cout << "  (" << std::setw(4) << j << ")"
-		    << "        ";
-	  write(std::cout, w.D);
-	  std::cout << "|";
-	  break;
-	case 4:
-	  std::cout << "--------"
-		    << "--------"
-		    << "--------"
-		    << "--------"
-		    << "|";
-	  break;
-	}
-      }
-      std::cout << "\n";
+      D[hj] = svgap;
+      cur.op[hj] = extend(up, CigarItem::RefGap);
+      trace[hj - from] = Kernel::FromRefGapOpen;
     }
   }
-#endif
-  
-  auto& final = result[query.size()];
-
-  if (!final.cigar.empty()) {
-    auto& first = final.cigar[0];
-    if (!scorer_.scoreRefStartGap() && first.isRefGap())
-      first = CigarItem(CigarItem::QuerySkipped, first.length());
-    else if (!scorer_.scoreQueryStartGap() && first.isQueryGap())
-      first = CigarItem(CigarItem::RefSkipped, first.length());
-    auto& last = final.cigar[final.cigar.size() - 1];
-    if (!scorer_.scoreRefEndGap() && last.isRefGap())
-      last = CigarItem(CigarItem::QuerySkipped, last.length());
-    else if (!scorer_.scoreQueryEndGap() && last.isQueryGap())
-      last = CigarItem(CigarItem::RefSkipped, last.length());
-  }
-
-  return final;
 }
 
 #endif // GLOBAL_ALIGNER_H_
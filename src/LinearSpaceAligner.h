@@ -0,0 +1,434 @@
+// This may look like C code, but it's really -*- C++ -*-
+/*
+ * Copyright Emweb BVBA, 3020 Herent, Belgium
+ *
+ * See LICENSE.txt for terms of use.
+ */
+#ifndef LINEAR_SPACE_ALIGNER_H_
+#define LINEAR_SPACE_ALIGNER_H_
+
+#include <limits>
+#include <vector>
+#include <algorithm>
+
+#include "Cigar.h"
+#include "SearchRange.h"
+#include "ColumnKernel.h"
+
+/*
+ * Divide-and-conquer (Hirschberg / Myers-Miller) evaluation of the
+ * GlobalAligner recurrence, using memory that is linear in the
+ * sequence length.
+ *
+ * The recurrence is viewed as a graph with per cell the nodes D, M,
+ * Q[SideN] (gap in query, with gap length phase) and P[SideN] (gap in
+ * ref). A forward pass computes the best score from the start node to
+ * the end node, and every cell gets the traceback of the
+ * ColumnKernel, so that ties are broken as in the GlobalAligner. Past
+ * the middle column, each node also keeps the node in the middle
+ * column at which its traceback leaves that column. For the end node,
+ * that node splits the alignment that the GlobalAligner traces back,
+ * and both halves are solved recursively, starting or ending in that
+ * node. This keeps the frameshift and misalignment (gap phase) states
+ * exact across the split, and gives the same alignment as the
+ * GlobalAligner: a traceback within a half follows the same
+ * predecessors as within the whole.
+ *
+ * Small sub-problems are solved directly with a score matrix and a
+ * traceback.
+ */
+template <class Scorer, class Reference, class Query, int SideN>
+class LinearSpaceAligner
+{
+public:
+  LinearSpaceAligner(Scorer& scorer, const Reference& ref, const Query& query,
+		     const SearchRange& sr);
+
+  /*
+   * Computes the optimal alignment, returning its score.
+   */
+  int align(Cigar& cigar);
+
+private:
+  static const int INVALID_SCORE;
+  static const long DIRECT_CELLS = 64 * 1024;
+
+  typedef ColumnKernel<SideN> Kernel;
+  typedef typename Kernel::TraceCell TraceCell;
+
+  enum {
+    D = Kernel::StateD,
+    M = Kernel::StateM,
+    Q0 = Kernel::StateQ,
+    P0 = Kernel::StateP,
+    StateCount = Kernel::StateCount
+  };
+
+  struct Cell {
+    int s[StateCount];
+    TraceCell t;
+  };
+
+  struct Column {
+    Column()
+      : first(0)
+    { }
+
+    int first;
+    std::vector<Cell> cells;
+
+    void reset(int startRow, int endRow) {
+      Cell invalid;
+      std::fill(invalid.s, invalid.s + StateCount, INVALID_SCORE);
+      invalid.t = Kernel::FromMatch;
+      first = startRow;
+      cells.assign(endRow - startRow, invalid);
+    }
+
+    int score(int row, int state) const {
+      int i = row - first;
+      if (i < 0 || i >= (int)cells.size())
+	return INVALID_SCORE;
+      else
+	return cells[i].s[state];
+    }
+
+    Cell& operator[](int row) { return cells[row - first]; }
+    const Cell& operator[](int row) const { return cells[row - first]; }
+  };
+
+  /*
+   * A node in the alignment graph. A state < 0 indicates the
+   * boundary column 0 (the start of the global alignment).
+   */
+  struct Node {
+    Node(int aColumn, int aRow, int aState)
+      : column(aColumn), row(aRow), state(aState)
+    { }
+
+    int column, row, state;
+  };
+
+  Scorer& scorer_;
+  const Reference& ref_;
+  const Query& query_;
+  std::vector<int> startRow_, endRow_, initScore_;
+
+  int solve(const Node& start, const Node& end, Cigar& cigar);
+  int solveDirect(const Node& start, const Node& end, Cigar& cigar);
+
+  template <bool Via = false>
+  void forwardColumn(Column& col, int c, const Column *prev,
+		     const Node *start, int r0, int r1,
+		     std::vector<int> *via = nullptr,
+		     const std::vector<int> *prevVia = nullptr);
+  static void middleVia(const Column& col, std::vector<int>& via);
+
+  static bool valid(int score) { return score > INVALID_SCORE / 2; }
+  static void append(Cigar& cigar, CigarItem item);
+};
+
+template <class Scorer, class Reference, class Query, int SideN>
+const int LinearSpaceAligner<Scorer, Reference, Query, SideN>::INVALID_SCORE
+  = std::numeric_limits<int>::min() / 2;
+
+template <class Scorer, class Reference, class Query, int SideN>
+LinearSpaceAligner<Scorer, Reference, Query, SideN>
+::LinearSpaceAligner(Scorer& scorer, const Reference& ref, const Query& query,
+		     const SearchRange& sr)
+  : scorer_(scorer),
+    ref_(ref),
+    query_(query),
+    startRow_(ref.size() + 1),
+    endRow_(ref.size() + 1),
+    initScore_(query.size() + 1)
+{
+  int startRow = 0;
+  for (unsigned hi = 0; hi < ref.size() + 1; ++hi) {
+    startRow = std::max(startRow, sr.startRow(hi));
+    startRow_[hi] = startRow;
+    endRow_[hi] = sr.endRow(hi);
+  }
+
+  /* Column 0: leading gap in the reference */
+  initScore_[0] = 0;
+  for (unsigned hj = 1; hj < query.size() + 1; ++hj) {
+    int j = hj - 1;
+    initScore_[hj] = initScore_[hj - 1];
+    if (j == 0)
+      initScore_[hj] += scorer_.scoreOpenRefGap(ref, query, -1, 0);
+    else
+      initScore_[hj] += scorer_.scoreExtendRefGap(ref, query, -1, j, j);
+  }
+  initScore_[0] = scorer_.scoreOpenQueryGap(ref, query, -1, -1);
+}
+
+template <class Scorer, class Reference, class Query, int SideN>
+int LinearSpaceAligner<Scorer, Reference, Query, SideN>::align(Cigar& cigar)
+{
+  cigar.clear();
+  return solve(Node(0, 0, -1), Node(ref_.size(), query_.size(), D), cigar);
+}
+
+template <class Scorer, class Reference, class Query, int SideN>
+int LinearSpaceAligner<Scorer, Reference, Query, SideN>
+::solve(const Node& start, const Node& end, Cigar& cigar)
+{
+  const int c0 = start.column, c1 = end.column;
+  const int r0 = start.row, r1 = end.row;
+
+  /* The cells within the search range */
+  long area = 0;
+  for (int c = c0; c <= c1; ++c)
+    area += std::max(0, std::min(r1 + 1, endRow_[c])
+		     - std::max(r0, startRow_[c]));
+
+  if (c1 - c0 <= 1 || area <= DIRECT_CELLS)
+    return solveDirect(start, end, cigar);
+
+  const int mid = (c0 + c1) / 2;
+
+  Column f, prev;
+  std::vector<int> via, prevVia;
+
+  forwardColumn(f, c0, nullptr, &start, r0, r1);
+  for (int c = c0 + 1; c <= c1; ++c) {
+    std::swap(f, prev);
+    if (c <= mid)
+      forwardColumn(f, c, &prev, nullptr, r0, r1);
+    else {
+      std::swap(via, prevVia);
+      forwardColumn<true>(f, c, &prev, nullptr, r0, r1, &via, &prevVia);
+    }
+    if (c == mid)
+      middleVia(f, via);
+  }
+
+  const int score = f.score(r1, end.state);
+  if (!valid(score))
+    return INVALID_SCORE;
+
+  const int v = via[(r1 - f.first) * StateCount + end.state];
+  if (v < 0)
+    return INVALID_SCORE;
+
+  Node split(mid, v / StateCount, v % StateCount);
+
+  solve(start, split, cigar);
+  solve(split, end, cigar);
+
+  return score;
+}
+
+template <class Scorer, class Reference, class Query, int SideN>
+template <bool Via>
+void LinearSpaceAligner<Scorer, Reference, Query, SideN>
+::forwardColumn(Column& col, int c, const Column *prev,
+		const Node *start, int r0, int r1,
+		std::vector<int> *via, const std::vector<int> *prevVia)
+{
+  const int from = std::max(r0, startRow_[c]);
+  const int to = std::max(from, std::min(r1 + 1, endRow_[c]));
+
+  col.reset(from, to);
+
+  /*
+   * The via of a node is that of its predecessor in the traceback,
+   * at index (row - first) * StateCount + state of its column
+   */
+  if (Via)
+    via->assign((to - from) * StateCount, -1);
+
+  auto viaOf = [&](const Column& column, const std::vector<int>& v,
+		   int row, int state) {
+    int r = row - column.first;
+    if (r < 0 || r >= (int)column.cells.size())
+      return -1;
+    else
+      return v[r * StateCount + state];
+  };
+
+  if (start && start->state < 0) {
+    for (int hj = from; hj < to; ++hj)
+      col[hj].s[D] = col[hj].s[M] = initScore_[hj];
+    return;
+  }
+
+  const int i = c - 1;
+
+  for (int hj = from; hj < to; ++hj) {
+    Cell& cell = col[hj];
+    const int j = hj - 1;
+
+    /* As in ColumnKernel::run() */
+    int hgap = INVALID_SCORE, vgap = INVALID_SCORE;
+    TraceCell ht = Kernel::FromQueryGapOpen, vt = Kernel::FromRefGapOpen;
+
+    int *cv = Via ? &(*via)[(hj - from) * StateCount] : nullptr;
+    int hv = -1, vv = -1;
+
+    if (prev) {
+      if (hj == 0) {
+	cell.s[D] = prev->score(0, D)
+	  + scorer_.scoreExtendQueryGap(ref_, query_, i, -1, i);
+	cell.s[M] = cell.s[D];
+	if (Via)
+	  cv[D] = cv[M] = viaOf(*prev, *prevVia, 0, D);
+	continue;
+      }
+
+      cell.s[M] = prev->score(hj - 1, D)
+	+ scorer_.scoreExtend(ref_, query_, i, j);
+      if (Via)
+	cv[M] = viaOf(*prev, *prevVia, hj - 1, D);
+
+      int sopen = prev->score(hj, M)
+	+ scorer_.scoreOpenQueryGap(ref_, query_, i, j);
+      const int mv = Via ? viaOf(*prev, *prevVia, hj, M) : -1;
+      hgap = sopen;
+      hv = mv;
+      for (int k = 0; k < SideN; ++k) {
+	int kN = (k + 1) % SideN;
+	int sK = prev->score(hj, Q0 + k)
+	  + scorer_.scoreExtendQueryGap(ref_, query_, i, j, kN);
+	int kv = Via ? viaOf(*prev, *prevVia, hj, Q0 + k) : -1;
+	if (k == SideN - 1) {
+	  bool open = sopen > sK;
+	  cell.s[Q0] = open ? sopen : sK;
+	  ht |= open ? (TraceCell)Kernel::QueryGapOpen : (TraceCell)0;
+	  if (Via)
+	    cv[Q0] = open ? mv : kv;
+	} else {
+	  cell.s[Q0 + kN] = sK;
+	  if (Via)
+	    cv[Q0 + kN] = kv;
+	}
+	const bool better = sK > hgap;
+	ht = better ? (TraceCell)((ht & Kernel::QueryGapOpen)
+				  | (Kernel::FromQueryGap + k)) : ht;
+	hv = better ? kv : hv;
+	hgap = better ? sK : hgap;
+      }
+    } else if (hj == start->row) {
+      cell.s[start->state] = 0;
+      if (hj == 0) {
+	cell.s[M] = cell.s[D] = 0;
+	continue;
+      }
+    }
+
+    if (hj > r0) {
+      int sopen = col.score(hj - 1, M)
+	+ scorer_.scoreOpenRefGap(ref_, query_, i, j);
+      const int mv = Via ? viaOf(col, *via, hj - 1, M) : -1;
+      vgap = sopen;
+      vv = mv;
+      for (int k = 0; k < SideN; ++k) {
+	int kN = (k + 1) % SideN;
+	int sK = col.score(hj - 1, P0 + k)
+	  + scorer_.scoreExtendRefGap(ref_, query_, i, j, kN);
+	int kv = Via ? viaOf(col, *via, hj - 1, P0 + k) : -1;
+	if (k == SideN - 1) {
+	  bool open = sopen > sK;
+	  cell.s[P0] = open ? sopen : sK;
+	  vt |= open ? (TraceCell)Kernel::RefGapOpen : (TraceCell)0;
+	  if (Via)
+	    cv[P0] = open ? mv : kv;
+	} else {
+	  cell.s[P0 + kN] = sK;
+	  if (Via)
+	    cv[P0 + kN] = kv;
+	}
+	const bool better = sK > vgap;
+	vt = better ? (TraceCell)((vt & Kernel::RefGapOpen)
+				  | (Kernel::FromRefGap + k)) : vt;
+	vv = better ? kv : vv;
+	vgap = better ? sK : vgap;
+      }
+    }
+
+    const int sm = cell.s[M];
+    const bool match = sm > hgap && sm > vgap;
+    cell.t = (ht & Kernel::QueryGapOpen) | (vt & Kernel::RefGapOpen)
+      | (match ? Kernel::FromMatch : ((hgap > vgap ? ht : vt) & Kernel::FromMask));
+    if (Via)
+      cv[D] = match ? cv[M] : (hgap > vgap ? hv : vv);
+
+    for (int s = M; s < StateCount; ++s)
+      cell.s[D] = std::max(cell.s[D], cell.s[s]);
+  }
+}
+
+template <class Scorer, class Reference, class Query, int SideN>
+void LinearSpaceAligner<Scorer, Reference, Query, SideN>
+::middleVia(const Column& col, std::vector<int>& via)
+{
+  /* A node (row, state) as row * StateCount + state, M in row 0 as D */
+  via.resize(col.cells.size() * StateCount);
+  for (unsigned r = 0; r < col.cells.size(); ++r) {
+    const int row = col.first + r;
+    for (int s = 0; s < StateCount; ++s)
+      via[r * StateCount + s] = row * StateCount + (row == 0 ? (int)D : s);
+  }
+}
+
+template <class Scorer, class Reference, class Query, int SideN>
+int LinearSpaceAligner<Scorer, Reference, Query, SideN>
+::solveDirect(const Node& start, const Node& end, Cigar& cigar)
+{
+  const int c0 = start.column, c1 = end.column;
+  const int r0 = start.row, r1 = end.row;
+
+  std::vector<Column> cols(c1 - c0 + 1);
+  forwardColumn(cols[0], c0, nullptr, &start, r0, r1);
+  for (int c = c0 + 1; c <= c1; ++c)
+    forwardColumn(cols[c - c0], c, &cols[c - c0 - 1], nullptr, r0, r1);
+
+  int c = c1, hj = r1, s = end.state;
+  const int score = cols[c - c0].score(hj, s);
+
+  if (!valid(score))
+    return INVALID_SCORE;
+
+  /* Trace back to start and construct cigar -- reverse in the end and append */
+  Cigar rCigar;
+
+  for (;;) {
+    if (hj == 0 && s == M)
+      s = D;
+
+    if (c == c0) {
+      if (start.state < 0) {
+	if (hj > 0)
+	  append(rCigar, CigarItem(CigarItem::RefGap, hj));
+	break;
+      } else if (hj == start.row && (s == start.state || hj == 0))
+	break;
+    }
+
+    if (hj == 0) {
+      append(rCigar, CigarItem(CigarItem::QueryGap));
+      --c;
+      continue;
+    }
+
+    append(rCigar, CigarItem(Kernel::traceBack(cols[c - c0][hj].t, s, c, hj)));
+  }
+
+  for (auto it = rCigar.rbegin(); it != rCigar.rend(); ++it)
+    append(cigar, *it);
+
+  return score;
+}
+
+template <class Scorer, class Reference, class Query, int SideN>
+void LinearSpaceAligner<Scorer, Reference, Query, SideN>
+::append(Cigar& cigar, CigarItem item)
+{
+  if (cigar.size() > 0 && cigar.back().op() == item.op())
+    cigar.back().add(item.length());
+  else
+    cigar.push_back(item);
+}
+
+#endif // LINEAR_SPACE_ALIGNER_H_
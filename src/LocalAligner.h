@@ -9,18 +9,22 @@
 
 #include <limits>
 #include <algorithm>
+#include <tuple>
 
 #include "LocalAlignments.h"
 #include "SubstitutionMatrix.h"
 #include "Cigar.h"
 #include "SearchRange.h"
+#include "StripeSize.h"
 
 template <class Scorer, class Reference, class Query, int SideN>
 class LocalAligner
 {
 public:
   LocalAligner(const Scorer& scorer)
-    : scorer_(scorer)
+    : scorer_(scorer),
+      memoryLimit_(1000UL*1000*1000),
+      stripeColumns_(0)
   { } 
 
   struct Solution {
@@ -33,37 +37,146 @@ public:
   Solution align(const Reference& seq1, const Query& seq2,
 		 const SearchRange& sr = SearchRange());
 
+  /*
+   * The score of the best local alignment, which ends with a match at
+   * (refEnd - 1, queryEnd - 1), or a score of 0 if there is none.
+   */
+  struct ScoreSolution {
+    ScoreSolution()
+      : score(0), refEnd(0), queryEnd(0) { }
+    int score;
+    int refEnd, queryEnd; // past end
+  };
+
+  /*
+   * Computes only the score of the best local alignment, keeping two
+   * columns of scores and no traceback.
+   */
+  ScoreSolution scoreOnly(const Reference& seq1, const Query& seq2);
+
   Scorer& scorer() { return scorer_; }
 
+  /*
+   * Limits the memory used for the matrix (in bytes, default 1 GB),
+   * by choosing the number of columns of the stripes in which the
+   * traceback is kept. A stripe has at least MinStripeColumns columns,
+   * even if that exceeds the limit.
+   */
+  void setMemoryLimit(unsigned long bytes) { memoryLimit_ = bytes; }
+  unsigned long memoryLimit() const { return memoryLimit_; }
+
+  /* The number of columns of a stripe in the last alignment */
+  unsigned stripeColumns() const { return stripeColumns_; }
+
+  /*
+   * At the end of each stripe, the best alignment is traced back for
+   * every cell and state of its last column, which costs about as much
+   * as computing a few hundred columns.
+   */
+  static const unsigned MinStripeColumns = 256;
+
 private:
   Scorer scorer_;
+  unsigned long memoryLimit_;
+  unsigned stripeColumns_;
 
-  struct ArrayItem {
-    ArrayItem()
-      : op(CigarItem::Match),
-	score(0)
-    { }
+  static const int INVALID_SCORE;
+
+  /*
+   * Scores of a cell, kept only for the current and previous
+   * column. The last op of D is only needed (and maintained) when
+   * SideN == 0, to score the gap extension.
+   */
+  struct ScoreItems {
+    ScoreItems()
+      : D(0),
+	M(0),
+	op(CigarItem::Match)
+    {
+      for (int k = 0; k < SideN; ++k)
+	P[k] = Q[k] = INVALID_SCORE;
+    }
 
+    int D, M;
+    int P[SideN]; // ending with k = 3n + SideN + 1 gaps in ref
+    int Q[SideN]; // ending with gaps in query
     CigarItem op;
-    int score;
   };
 
-  struct ArrayItems {
-    ArrayItem D, M;
-    ArrayItem P[SideN]; // ending with k = 3n + SideN + 1 gaps in ref
-    ArrayItem Q[SideN]; // ending with gaps in query
+  /*
+   * Traceback of a cell, packed in a byte: see GlobalAligner, with in
+   * addition whether D and M are not positive, where a local
+   * alignment starts.
+   */
+  typedef unsigned char TraceCell;
+
+  enum {
+    FromMatch = 0,          // M
+    FromQueryGapOpen = 1,   // M in the previous column
+    FromRefGapOpen = 2,     // M in the previous row
+    FromQueryGap = 3,       // + k: Q[k] in the previous column
+    FromRefGap = 3 + SideN, // + k: P[k] in the previous row
+    FromMask = 0x0F,
+    QueryGapOpen = 0x10,
+    RefGapOpen = 0x20,
+    ZeroD = 0x40,
+    ZeroM = 0x80
   };
 
-  LocalAlignment traceBack(int stripeI, int i, int j,
-			   const std::vector<std::vector<ArrayItems>>& work,
-			   const std::vector<LocalAlignment>& column0) const;
+  static_assert(FromRefGap + SideN <= FromMask + 1,
+		"SideN too large for the traceback encoding");
+
+  /* Traceback states */
+  enum {
+    StateD = -2,
+    StateM = -1,
+    StateQ = 0,    // + k
+    StateP = SideN // + k
+  };
+
+  typedef std::vector<ScoreItems> Column;
+  typedef std::vector<std::vector<TraceCell>> Trace;
+
+  /*
+   * The best local alignment that ends in each cell of the last column
+   * of a stripe, for each state in which a traceback can leave the
+   * next stripe: D, M (only when SideN > 0) and Q[k]. An empty cigar
+   * marks a cell where a local alignment starts.
+   */
+  typedef std::vector<std::vector<LocalAlignment>> Boundary;
+
+  static const int BoundaryStates = 2 + SideN;
+  static int boundaryIndex(int state) { return state - StateD; }
+
+  /*
+   * Traces back from cell (stripeI + i, j) in the given state, to where
+   * the local alignment starts, continuing with column0 from the first
+   * column of the stripe.
+   */
+  LocalAlignment traceBack(int stripeI, int i, int j, int state,
+			   const Trace& trace, const Boundary& column0) const;
+
+  /*
+   * Computes the scores of cell (i, j) from its neighbours, and
+   * returns its traceback.
+   */
+  TraceCell computeCell(const Reference& ref, const Query& query, int i, int j,
+			const ScoreItems& diag, const ScoreItems& left,
+			const ScoreItems& up, ScoreItems& c);
+
+  /* Whether a cell with traceback t ends a local alignment with a match */
+  static bool isMatch(TraceCell t) {
+    return !(t & ZeroD) && (t & FromMask) == FromMatch;
+  }
 };
 
+template <class Scorer, class Reference, class Query, int SideN>
+const int LocalAligner<Scorer, Reference, Query, SideN>::INVALID_SCORE = -10000;
+
 template <class Scorer, class Reference, class Query, int SideN>
 LocalAlignment LocalAligner<Scorer, Reference, Query, SideN>
-::traceBack(int stripeI, int i, int j,
-	    const std::vector<std::vector<ArrayItems>>& work,
-	    const std::vector<LocalAlignment>& column0) const
+::traceBack(int stripeI, int i, int j, int state, const Trace& trace,
+	    const Boundary& column0) const
 {
   LocalAlignment result;
   result.refEnd = stripeI + i + 1; // past end
@@ -72,94 +185,221 @@ LocalAlignment LocalAligner<Scorer, Reference, Query, SideN>
   int hi = i + 1;
   int hj = j + 1;
 
-  const ArrayItem *ai = &work[hi][hj].D;
-
-  if (ai->score <= 0)
-    return result;
-
   /* Trace back to start and construct cigar -- reverse in the end and append */
   Cigar rCigar;
-  CigarItem::Op lastOp;
-  
+
   for (;;) {
-    if (ai->score <= 0) {
-      switch (lastOp) {
-      case CigarItem::Match:
-	hi += 1;
-	hj += 1;
-	break;
-      case CigarItem::QueryGap:
-	hi += rCigar.back().length();
-	rCigar.pop_back();
-	break;
-      case CigarItem::RefGap:
-	hj += rCigar.back().length();
+    bool start;
+    TraceCell t = 0;
+
+    if (hi == 0) {
+      /*
+       * The first column of the stripe continues the solution of the
+       * last stripe that ends in the same state, unless a local
+       * alignment starts there
+       */
+      const LocalAlignment& last = column0[boundaryIndex(state)][hj];
+      start = last.cigar.empty();
+
+      if (!start) {
+	result.cigar = last.cigar;
+	result.refStart = last.refStart;
+	result.queryStart = last.queryStart;
+	if (rCigar.back().op() != result.cigar.back().op()) {
+	  result.cigar.insert(result.cigar.end(), rCigar.rbegin(), rCigar.rend());
+	} else {
+	  result.cigar.back().add(rCigar.back().length());
+	  result.cigar.insert(result.cigar.end(), rCigar.rbegin() + 1,
+			      rCigar.rend());
+	}
+
+	return result;
+      }
+    } else {
+      t = trace[hi - 1][hj];
+      start = (state == StateD && (t & ZeroD))
+	|| (state == StateM && (t & ZeroM));
+    }
+
+    if (start) {
+      /* A local alignment starts with a match */
+      while (!rCigar.empty() && rCigar.back().op() != CigarItem::Match) {
+	if (rCigar.back().op() == CigarItem::QueryGap)
+	  hi += rCigar.back().length();
+	else
+	  hj += rCigar.back().length();
 	rCigar.pop_back();
-	break;
       }
-      result.refStart = stripeI + hi - 1;
-      result.queryStart = hj - 1;
+
+      result.refStart = stripeI + hi;
+      result.queryStart = hj;
       result.cigar.insert(result.cigar.end(), rCigar.rbegin(), rCigar.rend());
       return result;
     }
 
-    rCigar.push_back(ai->op);
-    lastOp = ai->op.op();
-    switch (ai->op.op()) {
-    case CigarItem::Match:
-      hi -= ai->op.length();
-      hj -= ai->op.length();
-      break;
-    case CigarItem::QueryGap:
-      hi -= ai->op.length();
-      break;
-    case CigarItem::RefGap:
-      hj -= ai->op.length();
+    const int from = t & FromMask;
+    CigarItem::Op op;
+
+    if (state == StateD && from != FromMatch) {
+      if (from == FromQueryGapOpen
+	  || (from >= FromQueryGap && from < FromRefGap)) {
+	op = CigarItem::QueryGap;
+	--hi;
+      } else {
+	op = CigarItem::RefGap;
+	--hj;
+      }
+
+      if (from == FromQueryGapOpen || from == FromRefGapOpen)
+	state = StateM;
+      else if (op == CigarItem::QueryGap)
+	state = StateQ + from - FromQueryGap;
+      else
+	state = StateP + from - FromRefGap;
+    } else if (state == StateD || state == StateM) {
+      op = CigarItem::Match;
+      --hi;
+      --hj;
+      state = StateD;
+    } else if (state < StateP) {
+      op = CigarItem::QueryGap;
+      --hi;
+      if (state > StateQ)
+	--state;
+      else if (t & QueryGapOpen)
+	state = StateM;
+      else
+	state = StateQ + SideN - 1;
+    } else {
+      op = CigarItem::RefGap;
+      --hj;
+      if (state > StateP)
+	--state;
+      else if (t & RefGapOpen)
+	state = StateM;
+      else
+	state = StateP + SideN - 1;
     }
 
-    if (hi <= 0) {
-      /*
-       * Since we intialize work[0][..] from last solution, we may be going too far
-       */
-      int tooFar = 0 - hi;
-      rCigar.back().add(-tooFar);
-      if (ai->op.op() == CigarItem::Match)
-	hj += tooFar;
-      
-      break;
+    if (SideN == 0 && state == StateM)
+      state = StateD;
+
+    if (rCigar.size() > 0 && rCigar.back().op() == op)
+      rCigar.back().add();
+    else
+      rCigar.push_back(CigarItem(op));
+  }
+}
+
+
+template <class Scorer, class Reference, class Query, int SideN>
+typename LocalAligner<Scorer, Reference, Query, SideN>::TraceCell
+LocalAligner<Scorer, Reference, Query, SideN>
+::computeCell(const Reference& ref, const Query& query, int i, int j,
+	      const ScoreItems& diag, const ScoreItems& left,
+	      const ScoreItems& up, ScoreItems& c)
+{
+  TraceCell t = 0;
+
+  int sextend = diag.D + scorer_.scoreExtend(ref, query, i, j);
+  if (SideN > 0)
+    c.M = sextend;
+
+  int shgap = std::numeric_limits<int>::min();
+  int hgapFrom = FromQueryGapOpen;
+  if (SideN == 0) {
+    if (left.op.op() == CigarItem::Match)
+      shgap = left.D + scorer_.scoreOpenQueryGap(ref, query, i, j);
+    else if (left.op.op() == CigarItem::QueryGap)
+      shgap = left.D
+	+ scorer_.scoreExtendQueryGap(ref, query, i, j, left.op.length());
+  } else {
+    int shopengap = left.M + scorer_.scoreOpenQueryGap(ref, query, i, j);
+    shgap = shopengap;
+    for (int k = 0; k < SideN; ++k) {
+      int kN = (k + 1) % SideN;
+      int sK = left.Q[k] + scorer_.scoreExtendQueryGap(ref, query, i, j, kN);
+
+      if (k == SideN - 1 && shopengap > sK) {
+	c.Q[0] = shopengap;
+	t |= QueryGapOpen;
+      } else {
+	c.Q[kN] = sK;
+
+	if (sK > shgap) {
+	  shgap = sK;
+	  hgapFrom = FromQueryGap + k;
+	}
+      }
     }
+  }
+
+  int svgap = std::numeric_limits<int>::min();
+  int vgapFrom = FromRefGapOpen;
+  if (SideN == 0) {
+    if (up.op.op() == CigarItem::Match)
+      svgap = up.D + scorer_.scoreOpenRefGap(ref, query, i, j);
+    else if (up.op.op() == CigarItem::RefGap)
+      svgap = up.D
+	+ scorer_.scoreExtendRefGap(ref, query, i, j, up.op.length());
+  } else {
+    int svopengap = up.M + scorer_.scoreOpenRefGap(ref, query, i, j);
+    svgap = svopengap;
+    for (int k = 0; k < SideN; ++k) {
+      int kN = (k + 1) % SideN;
+      int sK = up.P[k] + scorer_.scoreExtendRefGap(ref, query, i, j, kN);
+
+      if (k == SideN - 1 && svopengap > sK) {
+	c.P[0] = svopengap;
+	t |= RefGapOpen;
+      } else {
+	c.P[kN] = sK;
 
-    if (hj < 0 || ai->op.length() == 0)
-      std::cerr << "Oops " << hi << ", " << hj << " length " << ai->op.length()
-		<< " score " << ai->score << std::endl;
-
-    if (SideN > 0) {
-      switch (ai->op.op()) {
-      case CigarItem::Match:
-	ai = &work[hi][hj].D;
-	break;
-      case CigarItem::QueryGap:
-      case CigarItem::RefGap:
-	ai = &work[hi][hj].M;
+	if (sK > svgap) {
+	  svgap = sK;
+	  vgapFrom = FromRefGap + k;
+	}
       }
-    } else
-      ai = &work[hi][hj].D;
+    }
   }
 
-  /* Combine with last solution at hj */
-  result.cigar = column0[hj].cigar;
-  result.refStart = column0[hj].refStart;
-  result.queryStart = column0[hj].queryStart;
-  if (result.cigar.empty() || rCigar.back().op() != result.cigar.back().op()) {
-    result.cigar.insert(result.cigar.end(), rCigar.rbegin(), rCigar.rend());
+  CigarItem::Op op;
+
+  if (sextend > shgap && sextend > svgap) {
+    c.D = sextend;
+    op = CigarItem::Match;
+    t |= FromMatch;
+    if (SideN == 0)
+      c.op = extend(diag.op, op);
+  } else if (shgap > svgap) {
+    c.D = shgap;
+    op = CigarItem::QueryGap;
+    t |= hgapFrom;
+    if (SideN == 0)
+      c.op = extend(left.op, op);
   } else {
-    result.cigar.back().add(rCigar.back().length());
-    result.cigar.insert(result.cigar.end(), rCigar.rbegin() + 1, rCigar.rend());
+    c.D = svgap;
+    op = CigarItem::RefGap;
+    t |= vgapFrom;
+    if (SideN == 0)
+      c.op = extend(up.op, op);
   }
 
-  return result;
-}
+  if (c.D > 0) {
+    if (SideN > 0 && c.M <= 0)
+      t |= ZeroM;
+  } else {
+    c.D = 0;
+    c.M = 0;
+    c.op = CigarItem(CigarItem::Match, 0);
+    t = ZeroD | ZeroM;
 
+    for (unsigned k = 0; k < SideN; ++k)
+      c.P[k] = c.Q[k] = INVALID_SCORE;
+  }
+
+  return t;
+}
 
 template <class Scorer, class Reference, class Query, int SideN>
 typename LocalAligner<Scorer, Reference, Query, SideN>::Solution
@@ -167,203 +407,97 @@ LocalAligner<Scorer, Reference, Query, SideN>::align(const Reference& ref, const
 						     const SearchRange&)
 {
   /*
-   * Like Needlemanwunsch but keep the best solution for
-   * each column: as cigar + score
-   */  
-  std::vector<LocalAlignment> column(query.size() + 1);
-
-  for (unsigned j = 0; j < query.size(); ++j) {
-    unsigned hj = j + 1;
-    column[hj].cigar.addRefGap();
-    column[hj].queryStart = j;
-  }
-
-  column[0].cigar.push_back(CigarItem(CigarItem::QueryGap, 0));
-  column[0].refStart = 0;
+   * Like Needlemanwunsch but keep the best solution for each cell of
+   * the last column of a stripe: as cigar, for each state. Before the
+   * first column, a local alignment starts in every cell.
+   */
+  Boundary column(BoundaryStates,
+		  std::vector<LocalAlignment>(query.size() + 1));
+  Boundary nextColumn = column;
 
   std::vector<LocalAlignment> row(ref.size()); // highest score per column as cigar
 
-  const unsigned N = std::min(ref.size(), 10000*1000 / query.size());
-
-  std::vector<std::vector<ArrayItems>> work(N + 1, std::vector<ArrayItems>(query.size() + 1));
-
-  static const int INVALID_SCORE = -10000;
+  /*
+   * Scores of the previous and current column, and the traceback of
+   * a stripe of N columns, within the memory limit together with the
+   * columns and the best alignment of each row and column.
+   */
+  const unsigned N
+    = chooseStripeColumns(memoryLimit_, ref.size(),
+			  (query.size() + 1) * sizeof(TraceCell)
+			  + sizeof(std::vector<TraceCell>), 0,
+			  (query.size() + 1)
+			  * (2 * sizeof(ScoreItems)
+			     + 2 * BoundaryStates * sizeof(LocalAlignment))
+			  + ref.size() * sizeof(LocalAlignment),
+			  MinStripeColumns);
+  stripeColumns_ = N;
+
+  Column prev(query.size() + 1), cur(query.size() + 1);
+  Trace trace(N, std::vector<TraceCell>(query.size() + 1));
+
+  for (unsigned hj = 1; hj < query.size() + 1; ++hj)
+    prev[hj].op = CigarItem(CigarItem::RefGap);
+  prev[0].op = CigarItem(CigarItem::QueryGap, 0);
 
   for (unsigned stripeI = 0; stripeI < ref.size(); stripeI += N) {
     std::cerr << stripeI << "/" << ref.size() << " ..." << std::endl;
     
     unsigned n = std::min((unsigned)(ref.size() - stripeI), N);
 
-    if (stripeI == 0) {
-      for (unsigned hj = 0; hj < query.size() + 1; ++hj) {
-	work[0][hj].D.score = 0;
-	work[0][hj].D.op = column[hj].cigar.back();
-	work[0][hj].M = work[0][hj].D;
-
-	for (unsigned k = 0; k < SideN; ++k) {
-	  work[0][hj].P[k].score = INVALID_SCORE;
-	  work[0][hj].P[k].op = CigarItem(CigarItem::RefGap, 0);
-	  work[0][hj].Q[k].score = INVALID_SCORE;
-	  work[0][hj].Q[k].op = CigarItem(CigarItem::QueryGap, 0);
-	}
-      }
-      work[0][0].D.op = CigarItem(CigarItem::QueryGap, 0);
-      work[0][0].M = work[0][0].D;
-    } else {
-      work[0] = work[N];
-    }
-
     for (unsigned i = stripeI; i < stripeI + n; ++i) {
       unsigned hi = i - stripeI + 1;
+      std::vector<TraceCell>& tr = trace[hi - 1];
 
-      work[hi][0] = work[hi - 1][0];
-      work[hi][0].D.op.add();
-      work[hi][0].M = work[hi][0].D;
+      cur[0] = prev[0];
+      cur[0].op.add();
+      cur[0].M = cur[0].D;
+      tr[0] = ZeroD | ZeroM;
 
       int bestScore = std::numeric_limits<int>::min();
       int bestJ = -1;
       
       for (unsigned j = 0; j < query.size(); ++j) {
 	unsigned hj = j + 1;
-	
-	int sextend = work[hi - 1][hj - 1].D.score + scorer_.scoreExtend(ref, query, i, j);
-	if (SideN > 0) {
-	  work[hi][hj].M.score = sextend;
-	  work[hi][hj].M.op = extend(work[hi - 1][hj - 1].D.op, CigarItem::Match);
-	}
 
-	int shgap = std::numeric_limits<int>::min();
-	CigarItem hgapLastOp(CigarItem::Match);
-	if (SideN == 0) {
-	  hgapLastOp = work[hi - 1][hj].D.op;
-	  if (hgapLastOp.op() == CigarItem::Match)
-	    shgap = work[hi - 1][hj].D.score + scorer_.scoreOpenQueryGap(ref, query, i, j);
-	  else if (hgapLastOp.op() == CigarItem::QueryGap)
-	    shgap = work[hi - 1][hj].D.score
-	      + scorer_.scoreExtendQueryGap(ref, query, i, j, hgapLastOp.length());
-	} else {
-	  int shopengap = work[hi - 1][hj].M.score + scorer_.scoreOpenQueryGap(ref, query, i, j);
-	  shgap = shopengap;
-	  hgapLastOp = work[hi - 1][hj].M.op;
-	  for (int k = 0; k < SideN; ++k) {
-	    int kN = (k + 1) % SideN;
-	    int sK = work[hi - 1][hj].Q[k].score + scorer_.scoreExtendQueryGap(ref, query, i, j, kN);
-
-	    if (k == SideN - 1 && shopengap > sK) {
-	      work[hi][hj].Q[0].score = shopengap;
-	      work[hi][hj].Q[0].op = extend(work[hi - 1][hj].M.op, CigarItem::QueryGap);
-	    } else {
-	      work[hi][hj].Q[kN].score = sK;
-	      if (work[hi - 1][hj].Q[k].op.op() != CigarItem::QueryGap) {
-		std::cerr << "Oops Q " << k << " " << hi - 1 << ", " << hj << std::endl;
-	      }
-	      work[hi][hj].Q[kN].op = extend(work[hi - 1][hj].Q[k].op, CigarItem::QueryGap);
-
-	      if (sK > shgap) {
-		shgap = sK;
-		hgapLastOp = work[hi - 1][hj].Q[k].op;
-	      }
-	    }
-	  }
-	}
+	ScoreItems& c = cur[hj];
+	TraceCell t = computeCell(ref, query, i, j,
+				  prev[hj - 1], prev[hj], cur[hj - 1], c);
 
-	int svgap = std::numeric_limits<int>::min();
-	CigarItem vgapLastOp(CigarItem::Match);
-	if (SideN == 0) {
-	  vgapLastOp = work[hi][hj - 1].D.op;
-	  if (vgapLastOp.op() == CigarItem::Match)
-	    svgap = work[hi][hj - 1].D.score + scorer_.scoreOpenRefGap(ref, query, i, j);
-	  else if (vgapLastOp.op() == CigarItem::RefGap)
-	    svgap = work[hi][hj - 1].D.score
-	      + scorer_.scoreExtendRefGap(ref, query, i, j, vgapLastOp.length());
-	} else {
-	  int svopengap = work[hi][hj - 1].M.score + scorer_.scoreOpenRefGap(ref, query, i, j);
-	  svgap = svopengap;
-	  vgapLastOp = work[hi][hj - 1].M.op;
-	  for (int k = 0; k < SideN; ++k) {
-	    int kN = (k + 1) % SideN;
-	    int sK = work[hi][hj - 1].P[k].score + scorer_.scoreExtendRefGap(ref, query, i, j, kN);
-
-	    if (k == SideN - 1 && svopengap > sK) {
-	      work[hi][hj].P[0].score = svopengap;
-	      work[hi][hj].P[0].op = extend(work[hi][hj - 1].M.op, CigarItem::RefGap);
-	    } else {
-	      work[hi][hj].P[kN].score = sK;
-	      if (work[hi][hj - 1].P[k].op.op() != CigarItem::RefGap) {
-		std::cerr << "Oops P " << k << " " << hi << ", " << hj - 1 << std::endl;
-	      }
-	      work[hi][hj].P[kN].op = extend(work[hi][hj - 1].P[k].op, CigarItem::RefGap);
-
-	      if (sK > svgap) {
-		svgap = sK;
-		vgapLastOp = work[hi][hj - 1].P[k].op;
-	      }
-	    }
-	  }
+	if (isMatch(t) && c.D > bestScore) {
+	  bestScore = c.D;
+	  bestJ = j;
 	}
 
-	CigarItem::Op op;
-	CigarItem last(CigarItem::Match);
-
-	if (sextend > shgap && sextend > svgap) {
-	  work[hi][hj].D.score = sextend;
-	  op = CigarItem::Match;
-	  last = work[hi - 1][hj - 1].D.op;
-	  // std::cerr << "E ";
-	} else if (shgap > svgap) {
-	  work[hi][hj].D.score = shgap;
-	  op = CigarItem::QueryGap;
-	  last = hgapLastOp;
-	  // std::cerr << "D ";
-	} else {
-	  work[hi][hj].D.score = svgap;
-	  op = CigarItem::RefGap;
-	  last = vgapLastOp;
-	  // std::cerr << "I ";
-	}
-
-	if (work[hi][hj].D.score > 0) {
-	  work[hi][hj].D.op = extend(last, op);
-	  if (op == CigarItem::Match && work[hi][hj].D.score > bestScore) {
-	    bestScore = work[hi][hj].D.score;
-	    bestJ = j;
-	  }
-	} else {
-	  work[hi][hj].D.op = CigarItem(CigarItem::Match, 0);
-	  work[hi][hj].D.score = 0;
-	  work[hi][hj].M.op = CigarItem(CigarItem::Match, 0);
-	  work[hi][hj].M.score = 0;
-
-	  for (unsigned k = 0; k < SideN; ++k) {
-	    work[hi][hj].P[k].score = INVALID_SCORE;
-	    work[hi][hj].P[k].op = CigarItem(CigarItem::RefGap, 0);
-	    work[hi][hj].Q[k].score = INVALID_SCORE;
-	    work[hi][hj].Q[k].op = CigarItem(CigarItem::QueryGap, 0);
-	  }
-	}
+	tr[hj] = t;
       }
 
+      std::swap(prev, cur);
+
       // collect highest score cigar
       if (bestJ > 0) {
-	row[i] = traceBack(stripeI, i - stripeI, bestJ, work, column);
+	row[i] = traceBack(stripeI, i - stripeI, bestJ, StateD, trace, column);
 	row[i].score = bestScore;
       }
     }
-      
+
+    if (stripeI + n == ref.size())
+      break;
+
     // Extend solution
 
     const int i = n - 1;
-    for (int j = query.size() - 1; j >= 0; --j) {
-      int hi = i + 1;
-      int hj = j + 1;
-      //std::cerr << i << ", " << j << std::endl;
-      column[hj] = traceBack(stripeI, i, j, work, column);
-      column[hj].score = work[hi][hj].D.score;
-      //std::cerr << column[hj].score << ", " << column[hj].cigar << std::endl;
+    for (int j = -1; j < (int)query.size(); ++j) {
+      for (int state = StateD; state < StateQ + SideN; ++state) {
+	if (SideN == 0 && state == StateM)
+	  continue;
+
+	nextColumn[boundaryIndex(state)][j + 1]
+	  = traceBack(stripeI, i, j, state, trace, column);
+      }
     }
 
-    column[0].cigar.back().add(n);
-    column[0].refStart += n;
+    std::swap(column, nextColumn);
   }
 
   /*
@@ -420,4 +554,42 @@ LocalAligner<Scorer, Reference, Query, SideN>::align(const Reference& ref, const
   return result;
 }
 
+template <class Scorer, class Reference, class Query, int SideN>
+typename LocalAligner<Scorer, Reference, Query, SideN>::ScoreSolution
+LocalAligner<Scorer, Reference, Query, SideN>::scoreOnly(const Reference& ref,
+							 const Query& query)
+{
+  ScoreSolution result;
+
+  Column prev(query.size() + 1), cur(query.size() + 1);
+
+  for (unsigned hj = 1; hj < query.size() + 1; ++hj)
+    prev[hj].op = CigarItem(CigarItem::RefGap);
+  prev[0].op = CigarItem(CigarItem::QueryGap, 0);
+
+  for (unsigned i = 0; i < ref.size(); ++i) {
+    cur[0] = prev[0];
+    cur[0].op.add();
+    cur[0].M = cur[0].D;
+
+    for (unsigned j = 0; j < query.size(); ++j) {
+      unsigned hj = j + 1;
+
+      ScoreItems& c = cur[hj];
+      TraceCell t = computeCell(ref, query, i, j,
+				prev[hj - 1], prev[hj], cur[hj - 1], c);
+
+      if (isMatch(t) && c.D > result.score) {
+	result.score = c.D;
+	result.refEnd = i + 1;
+	result.queryEnd = j + 1;
+      }
+    }
+
+    std::swap(prev, cur);
+  }
+
+  return result;
+}
+
 #endif // LOCAL_ALIGNER_H_
@@ -1,6 +1,11 @@
 #ifndef LOCAL_ALIGNMENTS_H_
 #define LOCAL_ALIGNMENTS_H_
 
+#include <iostream>
+#include <set>
+
+#include "Cigar.h"
+
 struct LocalAlignment {
   Cigar cigar;
   int score;
@@ -0,0 +1,117 @@
+/*
+ * Copyright Emweb BVBA, 3020 Herent, Belgium
+ *
+ * See LICENSE.txt for terms of use.
+ */
+
+#include "MinimizerIndex.h"
+
+#include <algorithm>
+
+namespace {
+
+/* An invertible hash of a k-mer code, so that minimizers are not biased */
+std::uint64_t hash(std::uint64_t key, std::uint64_t mask)
+{
+  key = (~key + (key << 21)) & mask;
+  key = key ^ key >> 24;
+  key = ((key + (key << 3)) + (key << 8)) & mask;
+  key = key ^ key >> 14;
+  key = ((key + (key << 2)) + (key << 4)) & mask;
+  key = key ^ key >> 28;
+  key = (key + (key << 31)) & mask;
+  return key;
+}
+
+}
+
+MinimizerIndex::MinimizerIndex()
+  : k_(DefaultK),
+    w_(DefaultW)
+{ }
+
+MinimizerIndex::MinimizerIndex(const seq::NTSequence& ref, int k, int w)
+  : k_(k),
+    w_(w)
+{
+  entries_ = minimizers(ref);
+
+  std::sort(entries_.begin(), entries_.end(),
+	    [](const Entry& a, const Entry& b) {
+	      if (a.code != b.code)
+		return a.code < b.code;
+	      else
+		return a.pos < b.pos;
+	    });
+}
+
+std::vector<MinimizerIndex::Entry>
+MinimizerIndex::minimizers(const seq::NTSequence& s) const
+{
+  std::vector<Entry> result;
+
+  const std::uint64_t mask = (1ULL << (2 * k_)) - 1;
+  const int n = (int)s.size() - k_ + 1;
+  if (n <= 0)
+    return result;
+
+  /* The hash of the k-mer at each position, or ~0 if ambiguous */
+  const std::uint64_t None = ~0ULL;
+  std::vector<std::uint64_t> codes(n, None), hashes(n, None);
+
+  std::uint64_t code = 0;
+  int valid = 0; // unambiguous nucleotides up to i
+  for (int i = 0; i < (int)s.size(); ++i) {
+    if (s[i].isSimple()) {
+      code = ((code << 2) | s[i].intRep()) & mask;
+      ++valid;
+    } else
+      valid = 0;
+
+    if (valid >= k_) {
+      codes[i - k_ + 1] = code;
+      hashes[i - k_ + 1] = hash(code, mask);
+    }
+  }
+
+  int last = -1;
+  const int windows = std::max(1, n - w_ + 1);
+  for (int start = 0; start < windows; ++start) {
+    const int end = std::min(n, start + w_);
+
+    int best = -1;
+    for (int i = start; i < end; ++i)
+      if (hashes[i] != None && (best == -1 || hashes[i] < hashes[best]))
+	best = i;
+
+    if (best != -1 && best != last) {
+      Entry e;
+      e.code = codes[best];
+      e.pos = best;
+      result.push_back(e);
+      last = best;
+    }
+  }
+
+  return result;
+}
+
+std::vector<Anchor> MinimizerIndex::anchors(const seq::NTSequence& query) const
+{
+  std::vector<Anchor> hits;
+
+  for (const auto& m : minimizers(query)) {
+    auto range = std::equal_range(entries_.begin(), entries_.end(), m,
+				  [](const Entry& a, const Entry& b) {
+				    return a.code < b.code;
+				  });
+
+    if (range.second - range.first > MaxOccurrences)
+      continue;
+
+    for (auto i = range.first; i != range.second; ++i)
+      hits.push_back(Anchor(i->pos, m.pos, k_));
+  }
+
+  return mergeAnchors(hits);
+}
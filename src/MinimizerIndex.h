@@ -0,0 +1,57 @@
+// This may look like C code, but it's really -*- C++ -*-
+/*
+ * Copyright Emweb BVBA, 3020 Herent, Belgium
+ *
+ * See LICENSE.txt for terms of use.
+ */
+#ifndef MINIMIZER_INDEX_H_
+#define MINIMIZER_INDEX_H_
+
+#include <vector>
+#include <cstdint>
+
+#include "NTSequence.h"
+#include "Anchors.h"
+
+/*
+ * An index of the (w, k)-minimizers of a reference sequence: of every
+ * w consecutive k-mers, the k-mer with the smallest hash. K-mers with
+ * an ambiguous nucleotide are not indexed.
+ *
+ * The minimizers of a query that occur in the reference give exact
+ * matches, which are merged into anchors along their diagonal.
+ */
+class MinimizerIndex
+{
+public:
+  static const int DefaultK = 15;
+  static const int DefaultW = 10;
+
+  /*
+   * Minimizers that occur more often than this in the reference are
+   * repeats, and are not used as anchors.
+   */
+  static const int MaxOccurrences = 16;
+
+  MinimizerIndex();
+  MinimizerIndex(const seq::NTSequence& ref, int k = DefaultK,
+		 int w = DefaultW);
+
+  bool empty() const { return entries_.empty(); }
+
+  /* The exact matches of query with the reference */
+  std::vector<Anchor> anchors(const seq::NTSequence& query) const;
+
+private:
+  struct Entry {
+    std::uint64_t code;
+    int pos;
+  };
+
+  int k_, w_;
+  std::vector<Entry> entries_; // sorted on code, then pos
+
+  std::vector<Entry> minimizers(const seq::NTSequence& s) const;
+};
+
+#endif // MINIMIZER_INDEX_H_
@@ -10,17 +10,16 @@
 NTSequence6AA::NTSequence6AA(const seq::NTSequence& ntSequence)
   : seq::NTSequence(ntSequence)
 {
-  aaSequence_[0].resize(size());
-  aaSequence_[1].resize(size());
+  aaRep_.resize(2 * size());
   for (unsigned i = 0; i < size(); ++i) {
     if (i + 2 < size()) {
-      aaSequence_[0][i] = seq::Codon::translate(begin() + i);
+      aaRep_[2 * i] = seq::Codon::translate(begin() + i).intRep();
       seq::NTSequence cod(begin() + i, begin() + i + 3);
       cod = cod.reverseComplement();
-      aaSequence_[1][i] = seq::Codon::translate(cod.begin());
+      aaRep_[2 * i + 1] = seq::Codon::translate(cod.begin()).intRep();
     } else {
-      aaSequence_[0][i] = seq::AminoAcid::X;
-      aaSequence_[1][i] = seq::AminoAcid::X;
+      aaRep_[2 * i] = seq::AminoAcid::AA_X;
+      aaRep_[2 * i + 1] = seq::AminoAcid::AA_X;
     }
   }
 }
@@ -7,20 +7,32 @@
 #ifndef NTSEQUENCE_6AA_H_
 #define NTSEQUENCE_6AA_H_
 
+#include <vector>
+
 #include "NTSequence.h"
 #include "AASequence.h"
 
+/*
+ * A nucleotide sequence with the translation of the codon at every
+ * position, on both strands. The translations are stored as
+ * seq::AminoAcid::intRep(), interleaved per position, for use as a
+ * lookup index while scoring.
+ */
 class NTSequence6AA : public seq::NTSequence
 {
 public:
   explicit NTSequence6AA(const seq::NTSequence& nucleotides);
 
   seq::AminoAcid translate(int pos, bool reverseComplement) const {
-    return aaSequence_[(int)reverseComplement][pos];
+    return seq::AminoAcid::fromRep(aaRep(pos, reverseComplement));
+  }
+
+  int aaRep(int pos, bool reverseComplement) const {
+    return aaRep_[2 * pos + (int)reverseComplement];
   }
 
 private:
-  seq::AASequence aaSequence_[2];
+  std::vector<std::int8_t> aaRep_;
 };
 
 #endif // NTSEQUENCE_6AA_H_
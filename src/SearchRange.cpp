@@ -35,40 +35,82 @@ SearchRange::SearchRange(int aColumns, int aRows)
   : columns(aColumns),
     rows(aRows)
 {
-  items.push_back(SearchRangeItem(SearchRangeItem::Rectangle,
-				  0, columns,
-				  0, rows));
+  addItem(SearchRangeItem(SearchRangeItem::Rectangle,
+			  0, columns,
+			  0, rows));
 }
 
-int SearchRange::startRow(int column) const
+void SearchRange::addItem(const SearchRangeItem& item)
 {
-  for (const auto& i : items) {
-    if (column < i.endColumn) {
-      switch (i.type) {
-      case SearchRangeItem::Rectangle:
-	return std::max(0, i.startRow);
-      case SearchRangeItem::Parallelogram:
-	return std::max(0, i.startRow + (column - i.startColumn));
-      }
-    }
+  items_.push_back(item);
+
+  /*
+   * A column takes its rows from the first item that ends after it,
+   * as in scanStartRow().
+   */
+  for (int c = columnRows_.size(); c < std::min(item.endColumn, columns); ++c)
+    columnRows_.push_back(itemRows(item, c));
+}
+
+void SearchRange::clear()
+{
+  items_.clear();
+  columnRows_.clear();
+}
+
+void SearchRange::widen(int startColumn, int endColumn, int margin)
+{
+  endColumn = std::min(endColumn, (int)columnRows_.size());
+  for (int c = std::max(0, startColumn); c < endColumn; ++c) {
+    columnRows_[c].start = std::max(0, columnRows_[c].start - margin);
+    columnRows_[c].end = std::min(rows, columnRows_[c].end + margin);
   }
+}
 
-  throw std::runtime_error("Incomplete search range not covering " + std::to_string(column));
+void SearchRange::narrow(int startColumn, int endColumn,
+			 int startRow, int endRow)
+{
+  endColumn = std::min(endColumn, (int)columnRows_.size());
+  for (int c = std::max(0, startColumn); c < endColumn; ++c) {
+    columnRows_[c].start = std::max(startRow, columnRows_[c].start);
+    columnRows_[c].end = std::max(columnRows_[c].start,
+				  std::min(endRow, columnRows_[c].end));
+  }
 }
 
-int SearchRange::endRow(int column) const
+SearchRange::ColumnRows SearchRange::itemRows(const SearchRangeItem& i,
+					      int column) const
 {
-  for (const auto& i : items) {
-    if (column < i.endColumn) {
-      switch (i.type) {
-      case SearchRangeItem::Rectangle:
-	return std::min(rows, i.endRow);
-      case SearchRangeItem::Parallelogram:
-	return std::min(rows, i.endRow + (column - i.startColumn));
-      }
-    }
+  ColumnRows result;
+
+  switch (i.type) {
+  case SearchRangeItem::Rectangle:
+    result.start = std::max(0, i.startRow);
+    result.end = std::min(rows, i.endRow);
+    break;
+  case SearchRangeItem::Parallelogram:
+    result.start = std::max(0, i.startRow + (column - i.startColumn));
+    result.end = std::min(rows, i.endRow + (column - i.startColumn));
   }
 
+  return result;
+}
+
+int SearchRange::scanStartRow(int column) const
+{
+  for (const auto& i : items_)
+    if (column < i.endColumn)
+      return itemRows(i, column).start;
+
+  throw std::runtime_error("Incomplete search range not covering " + std::to_string(column));
+}
+
+int SearchRange::scanEndRow(int column) const
+{
+  for (const auto& i : items_)
+    if (column < i.endColumn)
+      return itemRows(i, column).end;
+
   throw std::runtime_error("Incomplete search range not covering " +
 			   std::to_string(column));
 }
@@ -77,24 +119,33 @@ int SearchRange::maxRowCount() const
 {
   int result = 0;
 
-  for (const auto& i : items) {
-    int h = i.endRow - i.startRow;
-    if (h > result)
-      result = h;
-  }
+  for (int c = 0; c < columns; ++c)
+    result = std::max(result, endRow(c) - startRow(c));
 
   return result;
 }
 
+void SearchRange::refWindow(int padding, int& start, int& end) const
+{
+  int first = 0;
+  while (first < columns && endRow(first) <= 1)
+    ++first;
+
+  int last = columns - 1;
+  while (last > first && startRow(last) >= rows - 1)
+    --last;
+
+  /* Column c aligns reference position c - 1, also into the last row */
+  start = std::max(0, first - 1 - padding);
+  end = std::min(columns - 1, last + 1 + padding);
+}
+
 long SearchRange::size() const
 {
   long result = 0;
 
-  for (const auto& i : items) {
-    long h = i.endRow - i.startRow;
-    long w = i.endColumn - i.startColumn;
-    result += h * w;
-  }
+  for (int c = 0; c < columns; ++c)
+    result += std::max(0, endRow(c) - startRow(c));
 
   return result;
 }
@@ -106,7 +157,7 @@ SearchRange getSearchRange(const Cigar& seed,
     return SearchRange(refSize + 1, querySize + 1);
   else {
     SearchRange result(refSize + 1, querySize + 1);
-    result.items.clear();
+    result.clear();
     
     SearchRangeItem::Type currentType = SearchRangeItem::Rectangle;
 
@@ -129,7 +180,7 @@ SearchRange getSearchRange(const Cigar& seed,
 
 	    deviation += MARGIN;
 
-	    result.items.push_back
+	    result.addItem
 	      (SearchRangeItem(currentType,
 			       currentRefStart,
 			       refI,
@@ -149,10 +200,10 @@ SearchRange getSearchRange(const Cigar& seed,
       } else {
 	// terminate current non-aligned block
 	if (currentType == SearchRangeItem::Rectangle) {
-	  if (result.items.empty()) {
+	  if (result.empty()) {
 	    int s = refI - queryI - 10 * MARGIN;
 	    if (s > MARGIN) {
-	      result.items.push_back
+	      result.addItem
 		(SearchRangeItem(currentType,
 				 currentRefStart,
 				 s,
@@ -162,7 +213,7 @@ SearchRange getSearchRange(const Cigar& seed,
 	    }
 	  }
 
-	  result.items.push_back
+	  result.addItem
 	    (SearchRangeItem(currentType,
 			     currentRefStart,
 			     refI,
@@ -202,7 +253,7 @@ SearchRange getSearchRange(const Cigar& seed,
 
 	deviation += MARGIN;
 
-	result.items.push_back
+	result.addItem
 	  (SearchRangeItem(currentType,
 			   currentRefStart,
 			   refI,
@@ -217,7 +268,7 @@ SearchRange getSearchRange(const Cigar& seed,
     if (currentRefStart < refSize + 1) {
       int s = currentRefStart + (querySize - queryI + 10 * MARGIN);
       if (s < refSize + 1 - MARGIN) {
-	result.items.push_back
+	result.addItem
 	  (SearchRangeItem(SearchRangeItem::Rectangle,
 			   currentRefStart, s,
 			   currentQueryStart, querySize + 1));
@@ -225,7 +276,7 @@ SearchRange getSearchRange(const Cigar& seed,
 	currentQueryStart = querySize;
       }
             
-      result.items.push_back
+      result.addItem
 	(SearchRangeItem(SearchRangeItem::Rectangle,
 			 currentRefStart, refSize + 1,
 			 currentQueryStart, querySize + 1));
@@ -235,12 +286,32 @@ SearchRange getSearchRange(const Cigar& seed,
   }
 }
 
+Cigar bandSeed(const Cigar& alignment)
+{
+  Cigar result;
+
+  for (const auto& item : alignment) {
+    CigarItem::Op op = item.op();
+    if (op == CigarItem::RefGap)
+      op = CigarItem::QuerySkipped;
+    else if (op == CigarItem::QueryGap)
+      op = CigarItem::RefSkipped;
+
+    if (!result.empty() && result.back().op() == op)
+      result.back().add(item.length());
+    else
+      result.push_back(CigarItem(op, item.length()));
+  }
+
+  return result;
+}
+
 std::ostream& operator<<(std::ostream& o, const SearchRange& sr)
 {
   std::cerr << "SearchRange [";
 
   bool first = true;
-  for (const auto& i : sr.items) {
+  for (const auto& i : sr.items()) {
     if (!first)
       std::cerr << ",";
     std::cerr << std::endl << "  " << i;
@@ -19,25 +19,97 @@ struct SearchRangeItem {
   int startRow, endRow;
 };
 
+/*
+ * A cell (ref position, query position) that an alignment aligns as a
+ * match: the alignment before and after it are independent.
+ */
+struct SplitPoint {
+  SplitPoint(int aRefPos, int aQueryPos)
+    : refPos(aRefPos), queryPos(aQueryPos)
+  { }
+
+  int refPos, queryPos;
+};
+
 struct SearchRange {
   SearchRange();
   SearchRange(int aColumns, int aRows);
 
-  int startRow(int column) const;
-  int endRow(int column) const;
-  
-  std::vector<SearchRangeItem> items;
+  /*
+   * Adds an item, covering the columns after the previous items up to
+   * its end column. The rows of these columns are added to the table
+   * that startRow() and endRow() look up, so that it is always current.
+   */
+  void addItem(const SearchRangeItem& item);
+
+  /* Removes all items, and the rows of all columns */
+  void clear();
+
+  bool empty() const { return items_.empty(); }
+  const std::vector<SearchRangeItem>& items() const { return items_; }
+
+  /*
+   * Widens the rows of the columns [startColumn, endColumn) by margin
+   * rows before and after. This changes the table, and not the items.
+   */
+  void widen(int startColumn, int endColumn, int margin);
+
+  /*
+   * Narrows the rows of the columns [startColumn, endColumn) to at
+   * most the rows [startRow, endRow). This changes the table, and not
+   * the items.
+   */
+  void narrow(int startColumn, int endColumn, int startRow, int endRow);
+
+  int startRow(int column) const {
+    return column < (int)columnRows_.size()
+      ? columnRows_[column].start : scanStartRow(column);
+  }
+
+  int endRow(int column) const {
+    return column < (int)columnRows_.size()
+      ? columnRows_[column].end : scanEndRow(column);
+  }
 
   int maxRowCount() const;
 
+  /*
+   * The reference positions [start, end) that an alignment within the
+   * range can align, extended by padding positions on both sides.
+   * Outside of these, the range holds only its first row (before) or
+   * its last row (after), where an alignment skips the reference.
+   */
+  void refWindow(int padding, int& start, int& end) const;
+
+  /* The number of cells */
   long size() const;
   
   int columns, rows;
+
+private:
+  struct ColumnRows {
+    int start, end;
+  };
+
+  std::vector<SearchRangeItem> items_;
+  std::vector<ColumnRows> columnRows_;
+
+  int scanStartRow(int column) const;
+  int scanEndRow(int column) const;
+  ColumnRows itemRows(const SearchRangeItem& item, int column) const;
 };
 
 extern SearchRange getSearchRange(const Cigar& seed,
 				  int refSize, int querySize, int margin = 150);
 
+/*
+ * A seed for getSearchRange() that follows an alignment: its gaps
+ * become skipped positions, so that the search range narrows to the
+ * margin after each gap, instead of widening around the whole
+ * alignment by the total length of its gaps.
+ */
+extern Cigar bandSeed(const Cigar& alignment);
+
 extern std::ostream& operator<<(std::ostream& o, const SearchRangeItem& sri);
 extern std::ostream& operator<<(std::ostream& o, const SearchRange& sr);
 
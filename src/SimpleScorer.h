@@ -204,6 +204,54 @@ public:
       return gapExtensionCost_;
   }
 
+  /*
+   * The scores of the cells in column refI, as computed by the cell
+   * scores above (see GenomeScorer::Column).
+   */
+  class Column
+  {
+  public:
+    Column(SimpleScorer& scorer, const Sequence& ref, int refI)
+      : scorer_(scorer),
+	ref_(ref),
+	refI_(refI),
+	row_(scorer.weightMatrix_[ref[refI].intRep()])
+    { }
+
+    int scoreExtend(const Sequence& query, int queryI) const {
+      return row_[query[queryI].intRep()];
+    }
+
+    int scoreOpenRefGap(const Sequence& query, int queryI) const {
+      return scorer_.scoreOpenRefGap(ref_, query, refI_, queryI);
+    }
+
+    int scoreExtendRefGap(const Sequence& query, int queryI, int k) const {
+      return scorer_.scoreExtendRefGap(ref_, query, refI_, queryI, k);
+    }
+
+    int scoreOpenQueryGap(const Sequence& query, int queryI) const {
+      return scorer_.scoreOpenQueryGap(ref_, query, refI_, queryI);
+    }
+
+    int scoreExtendQueryGap(const Sequence& query, int queryI, int k) const {
+      return scorer_.scoreExtendQueryGap(ref_, query, refI_, queryI, k);
+    }
+
+  private:
+    SimpleScorer& scorer_;
+    const Sequence& ref_;
+    const int refI_;
+    const int *row_;
+  };
+
+  /* Calls f(column) with the Column for refI */
+  template <class F>
+  void forColumn(const Sequence& ref, int refI, F& f)
+  {
+    f(Column(*this, ref, refI));
+  }
+
   double calcScore(const Sequence& ref, const Sequence& query,
 		   int frameshiftCount) const
   {
@@ -16,6 +16,9 @@ public:
     v_.resize(end - start);
   }
 
+  int start() const { return first_; }
+  int end() const { return first_ + v_.size(); }
+
   const E& at(int index) const {
     int i = index - first_;
     if (i < 0 || i >= v_.size())
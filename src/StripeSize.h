@@ -0,0 +1,71 @@
+// This may look like C code, but it's really -*- C++ -*-
+/*
+ * Copyright Emweb BVBA, 3020 Herent, Belgium
+ *
+ * See LICENSE.txt for terms of use.
+ */
+#ifndef STRIPE_SIZE_H_
+#define STRIPE_SIZE_H_
+
+#include <algorithm>
+#include <cmath>
+
+/*
+ * Returns the number of columns of a stripe so that the memory used
+ * for aligning against a reference of the given number of columns
+ * stays within memoryLimit (in bytes), given:
+ *  - traceColumnBytes: the traceback kept for each column of a stripe,
+ *  - stripeBytes: the memory kept for each stripe (e.g. its boundary
+ *    column),
+ *  - fixedBytes: the memory used regardless of the stripe size,
+ *  - minColumns: the narrowest stripe that may be used.
+ *
+ * This is the widest stripe that fits. If none fits, the limit will be
+ * exceeded, and the stripe width that uses the least memory is
+ * returned instead.
+ */
+inline unsigned chooseStripeColumns(unsigned long memoryLimit,
+				    unsigned columns,
+				    unsigned long traceColumnBytes,
+				    unsigned long stripeBytes,
+				    unsigned long fixedBytes,
+				    unsigned minColumns = 1)
+{
+  if (columns <= std::max(1U, minColumns))
+    return std::max(1U, columns);
+
+  auto bytes = [&](unsigned long n) {
+    return fixedBytes + n * traceColumnBytes
+      + (columns + n - 1) / n * stripeBytes;
+  };
+
+  /*
+   * The memory use is smallest around
+   * n = sqrt(columns * stripeBytes / traceColumnBytes)
+   */
+  unsigned long best = std::sqrt((double)columns * stripeBytes
+				 / traceColumnBytes);
+  best = std::min((unsigned long)columns, std::max(1UL, best));
+  while (best > 1 && bytes(best - 1) <= bytes(best))
+    --best;
+  while (best < columns && bytes(best + 1) < bytes(best))
+    ++best;
+  best = std::max(best, (unsigned long)minColumns);
+
+  if (bytes(best) > memoryLimit)
+    return best;
+
+  /* Beyond best, memory use only grows with n */
+  unsigned long lo = best, hi = columns;
+  while (lo < hi) {
+    unsigned long mid = lo + (hi - lo + 1) / 2;
+    if (bytes(mid) <= memoryLimit)
+      lo = mid;
+    else
+      hi = mid - 1;
+  }
+
+  return lo;
+}
+
+#endif // STRIPE_SIZE_H_
@@ -0,0 +1,172 @@
+/*
+ * Copyright Emweb BVBA, 3020 Herent, Belgium
+ *
+ * See LICENSE.txt for terms of use.
+ */
+
+#include "TranslatedIndex.h"
+#include "Genome.h"
+#include "NTSequence6AA.h"
+
+#include <algorithm>
+
+namespace {
+
+const int AlphabetSize = 10;
+
+/*
+ * The reduced alphabet letter of an amino acid (by intRep()), or -1
+ * for a stop codon or an unknown amino acid.
+ */
+int reducedRep(int aaRep)
+{
+  static const int letters[] = {
+    2,  // A
+    1,  // C
+    7,  // D
+    7,  // E
+    6,  // F
+    3,  // G
+    9,  // H
+    0,  // I
+    8,  // K
+    0,  // L
+    0,  // M
+    7,  // N
+    5,  // P
+    7,  // Q
+    8,  // R
+    4,  // S
+    4,  // T
+    0,  // V
+    6,  // W
+    6,  // Y
+    -1, // *
+    -1, // -
+    7,  // Z
+    1,  // U
+    7,  // B
+    -1, // X
+    0   // J
+  };
+
+  if (aaRep >= 0 && aaRep < (int)(sizeof(letters) / sizeof(letters[0])))
+    return letters[aaRep];
+  else
+    return -1;
+}
+
+/*
+ * The code of the k amino acids aaRep(0) .. aaRep(k - 1), or -1 if
+ * one of them is not in the reduced alphabet.
+ */
+template <typename F>
+int kmerCode(int k, F aaRep)
+{
+  int result = 0;
+  for (int t = 0; t < k; ++t) {
+    int l = reducedRep(aaRep(t));
+    if (l < 0)
+      return -1;
+    result = result * AlphabetSize + l;
+  }
+
+  return result;
+}
+
+/* The amino acid of the codon on the given strand at pos, or -1 */
+int codonAa(const Genome& ref, int pos, bool reverseComplement)
+{
+  if (pos >= ref.size())
+    return -1;
+
+  for (const auto& c : ref.codons(pos))
+    if (c.reverseComplement == reverseComplement)
+      return c.aa;
+
+  return -1;
+}
+
+}
+
+TranslatedIndex::TranslatedIndex()
+  : k_(DefaultK)
+{ }
+
+TranslatedIndex::TranslatedIndex(const Genome& ref, int k)
+  : k_(k)
+{
+  /*
+   * A k-mer is a run of k codons of the same strand, at consecutive
+   * codon positions, as registered at their start by
+   * Genome::preprocess(). For a CDS on the reverse strand, this is the
+   * reverse of the protein, as is the reverse strand translation of
+   * the query.
+   */
+  for (int i = 0; i < ref.size(); ++i)
+    for (const auto& c : ref.codons(i)) {
+      const bool rc = c.reverseComplement;
+      int code = kmerCode(k_, [&](int t) {
+	  return codonAa(ref, i + 3 * t, rc);
+	});
+
+      if (code >= 0) {
+	Entry e;
+	e.code = code;
+	e.pos = i;
+	e.reverseComplement = rc;
+	entries_.push_back(e);
+      }
+    }
+
+  std::sort(entries_.begin(), entries_.end(),
+	    [](const Entry& a, const Entry& b) {
+	      if (a.reverseComplement != b.reverseComplement)
+		return a.reverseComplement < b.reverseComplement;
+	      else if (a.code != b.code)
+		return a.code < b.code;
+	      else
+		return a.pos < b.pos;
+	    });
+}
+
+std::vector<Anchor> TranslatedIndex::anchors(const seq::NTSequence& query) const
+{
+  std::vector<Anchor> hits;
+
+  if (entries_.empty())
+    return hits;
+
+  const NTSequence6AA translated(query);
+  const int length = 3 * k_;
+
+  for (int j = 0; j + length <= (int)translated.size(); ++j)
+    for (int strand = 0; strand < 2; ++strand) {
+      Entry q;
+      q.reverseComplement = strand == 1;
+      q.code = kmerCode(k_, [&](int t) {
+	  return translated.aaRep(j + 3 * t, q.reverseComplement);
+	});
+
+      if (q.code < 0)
+	continue;
+
+      auto range = std::equal_range(entries_.begin(), entries_.end(), q,
+				    [](const Entry& a, const Entry& b) {
+				      if (a.reverseComplement
+					  != b.reverseComplement)
+					return a.reverseComplement
+					  < b.reverseComplement;
+				      else
+					return a.code < b.code;
+				    });
+
+      if (range.second - range.first > MaxOccurrences)
+	continue;
+
+      for (auto i = range.first; i != range.second; ++i)
+	hits.push_back(Anchor(i->pos, j, length));
+    }
+
+  return mergeAnchors(hits);
+}
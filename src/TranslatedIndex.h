@@ -0,0 +1,57 @@
+// This may look like C code, but it's really -*- C++ -*-
+/*
+ * Copyright Emweb BVBA, 3020 Herent, Belgium
+ *
+ * See LICENSE.txt for terms of use.
+ */
+#ifndef TRANSLATED_INDEX_H_
+#define TRANSLATED_INDEX_H_
+
+#include <vector>
+
+#include "NTSequence.h"
+#include "Anchors.h"
+
+class Genome;
+
+/*
+ * An index of the amino acid k-mers of the CDS features of a genome,
+ * over a reduced amino acid alphabet (Murphy et al., 10 letters), so
+ * that the seeds survive both synonymous and conservative changes.
+ *
+ * The k-mers of a query are taken from its translation in the three
+ * frames of each strand (see NTSequence6AA), and their hits are
+ * mapped back to nucleotide anchors, on the codon positions, for
+ * divergent queries that have too few exact nucleotide matches.
+ */
+class TranslatedIndex
+{
+public:
+  static const int DefaultK = 5;
+
+  /*
+   * K-mers that occur more often than this in the reference are
+   * repeats, and are not used as anchors.
+   */
+  static const int MaxOccurrences = 16;
+
+  TranslatedIndex();
+  TranslatedIndex(const Genome& ref, int k = DefaultK);
+
+  bool empty() const { return entries_.empty(); }
+
+  /* The k-mer matches of the translations of query with the reference */
+  std::vector<Anchor> anchors(const seq::NTSequence& query) const;
+
+private:
+  struct Entry {
+    int code;
+    int pos;             // of the first nucleotide, in the forward strand
+    bool reverseComplement;
+  };
+
+  int k_;
+  std::vector<Entry> entries_; // sorted on reverseComplement, code, pos
+};
+
+#endif // TRANSLATED_INDEX_H_
@@ -0,0 +1,116 @@
+// This may look like C code, but it's really -*- C++ -*-
+/*
+ * Copyright Emweb BVBA, 3020 Herent, Belgium
+ *
+ * See LICENSE.txt for terms of use.
+ */
+#ifndef WAVEFRONT_H_
+#define WAVEFRONT_H_
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+
+/*
+ * Runs a grid of tiles (a, b), a < columns and b < rows, on a number
+ * of threads, where tile (a, b) starts only after tiles (a - 1, b) and
+ * (a, b - 1) have finished. Tiles along an anti-diagonal thus run in
+ * parallel.
+ *
+ * The tile function is called as tile(a, b). If a tile throws, no new
+ * tiles are started and the exception is rethrown by run().
+ */
+class Wavefront
+{
+public:
+  Wavefront(int columns, int rows)
+    : columns_(columns),
+      rows_(rows)
+  { }
+
+  template <class Tile>
+  void run(int threads, Tile tile);
+
+private:
+  int columns_, rows_;
+
+  std::mutex mutex_;
+  std::condition_variable changed_;
+  std::deque<std::pair<int, int>> ready_;
+  std::vector<int> done_; // number of finished tiles in each row
+  int remaining_;
+  std::exception_ptr error_;
+
+  template <class Tile>
+  void work(Tile& tile);
+};
+
+template <class Tile>
+void Wavefront::run(int threads, Tile tile)
+{
+  if (columns_ == 0 || rows_ == 0)
+    return;
+
+  done_.assign(rows_, 0);
+  ready_.clear();
+  ready_.push_back(std::make_pair(0, 0));
+  remaining_ = columns_ * rows_;
+  error_ = nullptr;
+
+  std::vector<std::thread> workers;
+  for (int t = 1; t < threads; ++t)
+    workers.push_back(std::thread([this, &tile]() { work(tile); }));
+
+  work(tile);
+
+  for (auto& w : workers)
+    w.join();
+
+  if (error_)
+    std::rethrow_exception(error_);
+}
+
+template <class Tile>
+void Wavefront::work(Tile& tile)
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+
+  for (;;) {
+    changed_.wait(lock, [this]() {
+	return !ready_.empty() || remaining_ == 0 || error_;
+      });
+
+    if (remaining_ == 0 || error_)
+      return;
+
+    std::pair<int, int> t = ready_.front();
+    ready_.pop_front();
+    const int a = t.first, b = t.second;
+
+    lock.unlock();
+    try {
+      tile(a, b);
+    } catch (...) {
+      lock.lock();
+      error_ = std::current_exception();
+      changed_.notify_all();
+      return;
+    }
+    lock.lock();
+
+    --remaining_;
+    done_[b] = a + 1;
+
+    if (a + 1 < columns_ && (b == 0 || done_[b - 1] > a + 1))
+      ready_.push_back(std::make_pair(a + 1, b));
+    if (b + 1 < rows_ && done_[b + 1] == a)
+      ready_.push_back(std::make_pair(a, b + 1));
+
+    changed_.notify_all();
+  }
+}
+
+#endif // WAVEFRONT_H_
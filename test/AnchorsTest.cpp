@@ -0,0 +1,132 @@
+/*
+ * Copyright Emweb BVBA, 3020 Herent, Belgium
+ *
+ * See LICENSE.txt for terms of use.
+ */
+
+#include <cstdio>
+#include <fstream>
+
+#include "Anchors.h"
+#include "TestData.h"
+
+bool sameAnchor(const Anchor& a, int refStart, int queryStart, int length)
+{
+  return a.refStart == refStart && a.queryStart == queryStart
+    && a.length == length;
+}
+
+Cigar cigar(const std::vector<CigarItem>& items)
+{
+  Cigar result;
+  result.insert(result.end(), items.begin(), items.end());
+  return result;
+}
+
+/* Writes the contents to a file, and reads anchors from it */
+bool readAnchorsFrom(const std::string& contents, std::vector<Anchor>& anchors)
+{
+  const std::string file = "anchors-test.txt";
+  {
+    std::ofstream f(file);
+    f << contents;
+  }
+
+  const bool result = readAnchors(file, anchors);
+  std::remove(file.c_str());
+
+  return result;
+}
+
+int main(int argc, char **argv)
+{
+  int failures = 0;
+
+  /* Overlapping and touching anchors on a diagonal are merged */
+  {
+    std::vector<Anchor> merged
+      = mergeAnchors({ Anchor(150, 50, 10), Anchor(100, 0, 30),
+		       Anchor(120, 20, 30), Anchor(300, 0, 20) });
+    CHECK(merged.size() == 2, failures);
+    CHECK(sameAnchor(merged[0], 100, 0, 60), failures);
+    CHECK(sameAnchor(merged[1], 300, 0, 20), failures);
+  }
+
+  /* An anchor on a conflicting diagonal is left out of the chain */
+  {
+    std::vector<Anchor> chain
+      = chainAnchors({ Anchor(0, 0, 50), Anchor(500, 100, 20),
+		       Anchor(100, 100, 50), Anchor(200, 200, 50) });
+    CHECK(chain.size() == 3, failures);
+    CHECK(sameAnchor(chain[0], 0, 0, 50), failures);
+    CHECK(sameAnchor(chain[1], 100, 100, 50), failures);
+    CHECK(sameAnchor(chain[2], 200, 200, 50), failures);
+  }
+
+  /* Of two anchors that cross, only one is chained */
+  {
+    std::vector<Anchor> chain
+      = chainAnchors({ Anchor(0, 100, 50), Anchor(100, 0, 60) });
+    CHECK(chain.size() == 1, failures);
+    CHECK(sameAnchor(chain[0], 100, 0, 60), failures);
+  }
+
+  /*
+   * Anchors that overlap in the query, on nearby diagonals, are
+   * chained, and the overlap is removed from the later one in the seed
+   */
+  {
+    std::vector<Anchor> chain
+      = chainAnchors({ Anchor(52, 45, 50), Anchor(0, 0, 50) });
+    CHECK(chain.size() == 2, failures);
+    CHECK(sameAnchor(chain[0], 0, 0, 50), failures);
+    CHECK(sameAnchor(chain[1], 52, 45, 50), failures);
+
+    Cigar seed = seedCigar(chain, 200, 100);
+    Cigar expected
+      = cigar({ CigarItem(CigarItem::Match, 50),
+		CigarItem(CigarItem::RefSkipped, 7),
+		CigarItem(CigarItem::Match, 45),
+		CigarItem(CigarItem::RefSkipped, 98),
+		CigarItem(CigarItem::QuerySkipped, 5) });
+    CHECK(seed.str() == expected.str(), failures);
+  }
+
+  /* Positions between anchors on one diagonal are matched in the seed */
+  {
+    Cigar seed = seedCigar(chainAnchors({ Anchor(10, 0, 20),
+					  Anchor(40, 30, 20) }), 60, 50);
+    Cigar expected
+      = cigar({ CigarItem(CigarItem::RefSkipped, 10),
+		CigarItem(CigarItem::Match, 50) });
+    CHECK(seed.str() == expected.str(), failures);
+  }
+
+  CHECK(chainAnchors(std::vector<Anchor>()).empty(), failures);
+  CHECK(seedCigar(std::vector<Anchor>(), 100, 100).empty(), failures);
+
+  /* Anchor files */
+  {
+    std::vector<Anchor> anchors;
+    CHECK(readAnchorsFrom("1 1 20\n\n101 51 30\n", anchors), failures);
+    CHECK(anchors.size() == 2, failures);
+    CHECK(sameAnchor(anchors[0], 0, 0, 20), failures);
+    CHECK(sameAnchor(anchors[1], 100, 50, 30), failures);
+  }
+
+  for (const char *malformed : { "1 1 20\n101 51\n", "1 1 20 5\n",
+	"1 a 20\n", "0 1 20\n", "1 1 0\n", "1 1 -20\n" }) {
+    std::vector<Anchor> anchors;
+    CHECK(!readAnchorsFrom(malformed, anchors), failures);
+  }
+
+  {
+    std::vector<Anchor> anchors;
+    CHECK(!readAnchors("no-such-anchors-file.txt", anchors), failures);
+  }
+
+  if (failures > 0)
+    std::cerr << failures << " checks failed" << std::endl;
+
+  return failures > 0 ? 1 : 0;
+}
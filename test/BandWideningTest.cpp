@@ -0,0 +1,61 @@
+/*
+ * Copyright Emweb BVBA, 3020 Herent, Belgium
+ *
+ * See LICENSE.txt for terms of use.
+ */
+
+#include "GlobalAligner.h"
+#include "TestData.h"
+
+/*
+ * Aligns a query against a search range around a seed that is shifted
+ * from the optimal alignment by about the margin of the range, and
+ * checks that widening the range where the alignment comes near its
+ * border recovers the optimal alignment, and that more widenings never
+ * result in a worse alignment.
+ */
+int main(int argc, char **argv)
+{
+  TestData data(3);
+
+  Genome ref = data.genome(6000);
+  seq::NTSequence query = data.query(ref, 0, ref.size());
+  NTSequence6AA query6AA(query);
+
+  typedef GlobalAligner<GenomeScorer, Genome, NTSequence6AA, 3> Aligner;
+  Aligner aligner(data.genomeScorer());
+
+  const int optimum = aligner.align(ref, query6AA).score;
+
+  int failures = 0;
+
+  const int shifts[] = { 150, 155, 160 };
+  for (int shift : shifts) {
+    Cigar seed;
+    seed.push_back(CigarItem(CigarItem::QuerySkipped, shift));
+    seed.push_back(CigarItem(CigarItem::Match, query.size() - shift));
+    seed.push_back(CigarItem(CigarItem::RefSkipped,
+			     ref.size() - (query.size() - shift)));
+    SearchRange sr = getSearchRange(seed, ref.size(), query.size());
+
+    int previous = 0;
+    for (int widenings = 0; widenings <= 3; ++widenings) {
+      aligner.setMaxBandWidenings(widenings);
+      const int score = aligner.align(ref, query6AA, sr).score;
+
+      if (widenings == 0)
+	CHECK(score < optimum, failures);
+      else
+	CHECK(score >= previous, failures);
+
+      previous = score;
+    }
+
+    CHECK(previous == optimum, failures);
+  }
+
+  if (failures > 0)
+    std::cerr << failures << " checks failed" << std::endl;
+
+  return failures > 0 ? 1 : 0;
+}
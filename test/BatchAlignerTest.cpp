@@ -0,0 +1,115 @@
+/*
+ * Copyright Emweb BVBA, 3020 Herent, Belgium
+ *
+ * See LICENSE.txt for terms of use.
+ */
+
+#include "BatchAligner.h"
+#include "GlobalAligner.h"
+#include "TestData.h"
+
+/*
+ * Aligns the queries with a BatchAligner, and checks that every
+ * solution equals that of a GlobalAligner for the same query and
+ * search range. In linear space, the GlobalAligner does not widen the
+ * search range when the alignment touches its border.
+ */
+template <class Scorer, class Reference, class Query, int SideN>
+int checkBatch(const Scorer& scorer, const Reference& ref,
+	       const std::vector<Query>& queries,
+	       const std::vector<SearchRange>& ranges,
+	       bool linearSpace = false)
+{
+  int failures = 0;
+
+  BatchAligner<Scorer, Reference, Query, SideN> batchAligner(scorer);
+  auto solutions = batchAligner.align(ref, queries, ranges);
+
+  CHECK(solutions.size() == queries.size(), failures);
+
+  for (unsigned q = 0; q < queries.size(); ++q) {
+    GlobalAligner<Scorer, Reference, Query, SideN> aligner(scorer);
+    aligner.setLinearSpace(linearSpace);
+    auto expected = aligner.align(ref, queries[q],
+				  ranges.empty() ? SearchRange() : ranges[q]);
+
+    CHECK(solutions[q].score == expected.score, failures);
+    CHECK(solutions[q].cigar.str() == expected.cigar.str(), failures);
+  }
+
+  return failures;
+}
+
+int main(int argc, char **argv)
+{
+  TestData data(42);
+
+  Genome ref = data.genome(1500);
+
+  /* Queries of different lengths, in two batches of 8 lanes */
+  std::vector<seq::NTSequence> queries;
+  std::vector<int> starts;
+  for (int q = 0; q < 11; ++q) {
+    int length = data.uniform(100, 800);
+    int start = data.uniform(0, ref.size() - length);
+    queries.push_back(data.query(ref, start, length));
+    starts.push_back(start);
+  }
+
+  /* Search ranges around the alignments, which do not touch the border */
+  std::vector<SearchRange> ranges;
+  {
+    GlobalAligner<GenomeScorer, Genome, NTSequence6AA, 3>
+      aligner(data.genomeScorer());
+    for (const auto& q : queries) {
+      Cigar seed = aligner.align(ref, NTSequence6AA(q)).cigar;
+      ranges.push_back(getSearchRange(seed, ref.size(), q.size(), 60));
+    }
+  }
+
+  /*
+   * Narrow search ranges around a diagonal that is off by a few
+   * positions, which exclude the optimal alignment.
+   */
+  std::vector<SearchRange> narrowRanges;
+  for (unsigned q = 0; q < queries.size(); ++q) {
+    const int length = queries[q].size();
+    const int start = std::min(starts[q] + 12, (int)ref.size() - length);
+
+    Cigar seed;
+    seed.push_back(CigarItem(CigarItem::RefSkipped, start));
+    seed.push_back(CigarItem(CigarItem::Match, length));
+    seed.push_back(CigarItem(CigarItem::RefSkipped,
+			     ref.size() - start - length));
+    narrowRanges.push_back(getSearchRange(seed, ref.size(), length, 4));
+  }
+
+  std::vector<NTSequence6AA> queries6AA;
+  for (const auto& q : queries)
+    queries6AA.push_back(NTSequence6AA(q));
+
+  int failures = 0;
+
+  failures += checkBatch<GenomeScorer, Genome, NTSequence6AA, 3>
+    (data.genomeScorer(), ref, queries6AA, std::vector<SearchRange>());
+  failures += checkBatch<GenomeScorer, Genome, NTSequence6AA, 3>
+    (data.genomeScorer(), ref, queries6AA, ranges);
+  failures += checkBatch<GenomeScorer, Genome, NTSequence6AA, 3>
+    (data.genomeScorer(), ref, queries6AA, narrowRanges, true);
+
+  typedef SimpleScorer<seq::NTSequence> NtScorer;
+  failures += checkBatch<NtScorer, seq::NTSequence, seq::NTSequence,
+			 NtScorer::SideN>
+    (data.ntScorer(), ref, queries, std::vector<SearchRange>());
+  failures += checkBatch<NtScorer, seq::NTSequence, seq::NTSequence,
+			 NtScorer::SideN>
+    (data.ntScorer(), ref, queries, ranges);
+  failures += checkBatch<NtScorer, seq::NTSequence, seq::NTSequence,
+			 NtScorer::SideN>
+    (data.ntScorer(), ref, queries, narrowRanges, true);
+
+  if (failures > 0)
+    std::cerr << failures << " checks failed" << std::endl;
+
+  return failures > 0 ? 1 : 0;
+}
@@ -0,0 +1,90 @@
+/*
+ * Copyright Emweb BVBA, 3020 Herent, Belgium
+ *
+ * See LICENSE.txt for terms of use.
+ */
+
+#include <random>
+
+#include "EditDistance.h"
+#include "TestData.h"
+
+/* The edit distance, with the full dynamic programming matrix */
+int simpleEditDistance(const seq::NTSequence& ref, const seq::NTSequence& query)
+{
+  std::vector<int> prev(query.size() + 1), cur(query.size() + 1);
+  for (unsigned j = 0; j <= query.size(); ++j)
+    prev[j] = j;
+
+  for (unsigned i = 1; i <= ref.size(); ++i) {
+    cur[0] = i;
+    for (unsigned j = 1; j <= query.size(); ++j) {
+      const int mismatch = ref[i - 1] == query[j - 1] ? 0 : 1;
+      cur[j] = std::min(prev[j - 1] + mismatch,
+			std::min(prev[j], cur[j - 1]) + 1);
+    }
+    std::swap(prev, cur);
+  }
+
+  return prev[query.size()];
+}
+
+seq::NTSequence randomSequence(std::mt19937& random, int length)
+{
+  static const char nucleotides[] = "ACGTN";
+  std::uniform_int_distribution<int> n(0, 4);
+
+  std::string s;
+  for (int i = 0; i < length; ++i)
+    s += nucleotides[n(random)];
+
+  return seq::NTSequence("s", "", s);
+}
+
+/* The sequence with about one in ten positions substituted */
+seq::NTSequence mutate(std::mt19937& random, const seq::NTSequence& s)
+{
+  seq::NTSequence result = s;
+  seq::NTSequence other = randomSequence(random, s.size());
+  std::uniform_int_distribution<int> p(0, 9);
+  for (unsigned i = 0; i < s.size(); ++i)
+    if (p(random) == 0)
+      result[i] = other[i];
+
+  return result;
+}
+
+/*
+ * Checks the bit-parallel edit distance against the full matrix, for
+ * queries of lengths around the 64 rows of a block, of several blocks,
+ * and empty, against references of the same lengths.
+ */
+int main(int argc, char **argv)
+{
+  std::mt19937 random(29);
+
+  int failures = 0;
+
+  const int lengths[] = { 0, 1, 63, 64, 65, 128, 200 };
+
+  for (int refLength : lengths)
+    for (int queryLength : lengths) {
+      seq::NTSequence ref = randomSequence(random, refLength);
+      seq::NTSequence query = randomSequence(random, queryLength);
+      CHECK(editDistance(ref, query) == simpleEditDistance(ref, query),
+	    failures);
+    }
+
+  for (int length : lengths) {
+    seq::NTSequence ref = randomSequence(random, length);
+    seq::NTSequence query = mutate(random, ref);
+    CHECK(editDistance(ref, ref) == 0, failures);
+    CHECK(editDistance(ref, query) == simpleEditDistance(ref, query),
+	  failures);
+  }
+
+  if (failures > 0)
+    std::cerr << failures << " checks failed" << std::endl;
+
+  return failures > 0 ? 1 : 0;
+}
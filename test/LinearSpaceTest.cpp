@@ -0,0 +1,98 @@
+/*
+ * Copyright Emweb BVBA, 3020 Herent, Belgium
+ *
+ * See LICENSE.txt for terms of use.
+ */
+
+#include "GlobalAligner.h"
+#include "TestData.h"
+
+/*
+ * Aligns the query in linear space and with the full matrix, and
+ * checks that both give the same alignment, also where other
+ * alignments have the same score.
+ */
+template <class Scorer, class Reference, class Query, int SideN>
+int checkLinearSpace(const Scorer& scorer, const Reference& ref,
+		     const Query& query, const SearchRange& sr = SearchRange())
+{
+  int failures = 0;
+
+  GlobalAligner<Scorer, Reference, Query, SideN> aligner(scorer);
+  auto expected = aligner.align(ref, query, sr);
+
+  aligner.setLinearSpace(true);
+  auto solution = aligner.align(ref, query, sr);
+
+  CHECK(solution.score == expected.score, failures);
+  CHECK(solution.cigar.str() == expected.cigar.str(), failures);
+
+  return failures;
+}
+
+int main(int argc, char **argv)
+{
+  TestData data(7);
+
+  typedef SimpleScorer<seq::NTSequence> NtScorer;
+
+  Genome ref = data.genome(3000);
+
+  int failures = 0;
+
+  /* Linear reference: whole and partial queries */
+  for (int q = 0; q < 3; ++q) {
+    int length = q == 0 ? ref.size() : data.uniform(500, 1500);
+    int start = data.uniform(0, ref.size() - length);
+    seq::NTSequence query = data.query(ref, start, length);
+
+    failures += checkLinearSpace<GenomeScorer, Genome, NTSequence6AA, 3>
+      (data.genomeScorer(), ref, NTSequence6AA(query));
+    failures += checkLinearSpace<NtScorer, seq::NTSequence, seq::NTSequence,
+				 NtScorer::SideN>
+      (data.ntScorer(), ref, query);
+
+    Cigar seed = GlobalAligner<GenomeScorer, Genome, NTSequence6AA, 3>
+      (data.genomeScorer()).align(ref, NTSequence6AA(query)).cigar;
+    SearchRange sr = getSearchRange(seed, ref.size(), query.size(), 100);
+
+    failures += checkLinearSpace<GenomeScorer, Genome, NTSequence6AA, 3>
+      (data.genomeScorer(), ref, NTSequence6AA(query), sr);
+  }
+
+  /*
+   * Circular reference, unwrapped as in aga: a query of the whole
+   * genome aligns equally well against both copies, and one starting
+   * near the end wraps around the origin.
+   */
+  {
+    Genome circular = ref;
+    circular.setGeometry(Genome::Geometry::Circular);
+
+    GenomeScorer scorer = data.genomeScorer();
+    Genome linearized = unwrapLinear(circular, scorer);
+    scorer.setScoreRefStartGap(true);
+    scorer.setScoreRefEndGap(true);
+
+    NtScorer ntScorer = data.ntScorer();
+    ntScorer.setScoreRefStartGap(true);
+    ntScorer.setScoreRefEndGap(true);
+
+    std::vector<seq::NTSequence> queries;
+    queries.push_back(data.query(ref, 0, ref.size(), 0.02, 0.001));
+    queries.push_back(data.query(linearized, ref.size() - 700, 1400));
+
+    for (const auto& query : queries) {
+      failures += checkLinearSpace<GenomeScorer, Genome, NTSequence6AA, 3>
+	(scorer, linearized, NTSequence6AA(query));
+      failures += checkLinearSpace<NtScorer, seq::NTSequence, seq::NTSequence,
+				   NtScorer::SideN>
+	(ntScorer, linearized, query);
+    }
+  }
+
+  if (failures > 0)
+    std::cerr << failures << " checks failed" << std::endl;
+
+  return failures > 0 ? 1 : 0;
+}
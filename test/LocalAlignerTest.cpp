@@ -0,0 +1,69 @@
+/*
+ * Copyright Emweb BVBA, 3020 Herent, Belgium
+ *
+ * See LICENSE.txt for terms of use.
+ */
+
+#include "LocalAligner.h"
+#include "TestData.h"
+
+/*
+ * Aligns the query within memory limits so low that the traceback is
+ * kept in several stripes, down to the narrowest stripes, and checks
+ * that this gives the same alignment as without a limit.
+ */
+template <class Scorer, class Reference, class Query, int SideN>
+int checkMemoryLimits(const Scorer& scorer, const Reference& ref,
+		      const Query& query)
+{
+  int failures = 0;
+
+  LocalAligner<Scorer, Reference, Query, SideN> aligner(scorer);
+  auto expected = aligner.align(ref, query);
+  CHECK(aligner.stripeColumns() == ref.size(), failures);
+
+  for (unsigned long limit : { 1UL, 2000000UL }) {
+    aligner.setMemoryLimit(limit);
+    auto solution = aligner.align(ref, query);
+
+    CHECK(aligner.stripeColumns() < ref.size(), failures);
+    CHECK(solution.score == expected.score, failures);
+    CHECK(solution.cigar.str() == expected.cigar.str(), failures);
+  }
+
+  return failures;
+}
+
+int main(int argc, char **argv)
+{
+  TestData data(5);
+
+  typedef SimpleScorer<seq::NTSequence> NtScorer;
+
+  Genome ref = data.genome(3000);
+
+  int failures = 0;
+
+  /* Part of the reference between unrelated flanks */
+  for (int q = 0; q < 3; ++q) {
+    int length = data.uniform(1000, 2000);
+    int start = data.uniform(0, ref.size() - length);
+
+    seq::NTSequence query = data.query(ref, 0, 50, 1, 0);
+    seq::NTSequence part = data.query(ref, start, length);
+    query.insert(query.end(), part.begin(), part.end());
+    seq::NTSequence flank = data.query(ref, 0, 50, 1, 0);
+    query.insert(query.end(), flank.begin(), flank.end());
+
+    failures += checkMemoryLimits<GenomeScorer, Genome, NTSequence6AA, 3>
+      (data.genomeScorer(), ref, NTSequence6AA(query));
+    failures += checkMemoryLimits<NtScorer, seq::NTSequence, seq::NTSequence,
+				  NtScorer::SideN>
+      (data.ntScorer(), ref, query);
+  }
+
+  if (failures > 0)
+    std::cerr << failures << " checks failed" << std::endl;
+
+  return failures > 0 ? 1 : 0;
+}
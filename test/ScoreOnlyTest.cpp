@@ -0,0 +1,66 @@
+/*
+ * Copyright Emweb BVBA, 3020 Herent, Belgium
+ *
+ * See LICENSE.txt for terms of use.
+ */
+
+#include "GlobalAligner.h"
+#include "LocalAligner.h"
+#include "TestData.h"
+
+typedef GlobalAligner<GenomeScorer, Genome, NTSequence6AA, 3> Aligner;
+
+/*
+ * Checks that scoreOnly() gives the score of align(), for a global
+ * alignment in the full matrix and in a band around a seed, with and
+ * without X-drop, and for a local alignment.
+ */
+int main(int argc, char **argv)
+{
+  TestData data(19);
+
+  Genome ref = data.genome(3000);
+
+  int failures = 0;
+
+  for (int q = 0; q < 3; ++q) {
+    const int length = data.uniform(1000, 2500);
+    const int start = data.uniform(0, ref.size() - length);
+    seq::NTSequence part = data.query(ref, start, length);
+    NTSequence6AA query(part);
+
+    Cigar seed;
+    seed.push_back(CigarItem(CigarItem::RefSkipped, start));
+    seed.push_back(CigarItem(CigarItem::Match, length));
+    seed.push_back(CigarItem(CigarItem::RefSkipped,
+			     ref.size() - start - length));
+    const SearchRange band = getSearchRange(seed, ref.size(), query.size(), 60);
+
+    Aligner aligner(data.genomeScorer());
+
+    for (int xDrop : { 0, 50, 200 }) {
+      aligner.setXDrop(xDrop * ref.scoreFactor());
+
+      for (const SearchRange& sr : { SearchRange(), band })
+	CHECK(aligner.scoreOnly(ref, query, sr)
+	      == aligner.align(ref, query, sr).score, failures);
+    }
+
+    /* The part between unrelated flanks, as a single local alignment */
+    seq::NTSequence flanked = data.query(ref, 0, 50, 1, 0);
+    flanked.insert(flanked.end(), part.begin(), part.end());
+    seq::NTSequence flank = data.query(ref, 0, 50, 1, 0);
+    flanked.insert(flanked.end(), flank.begin(), flank.end());
+
+    LocalAligner<GenomeScorer, Genome, NTSequence6AA, 3>
+      localAligner(data.genomeScorer());
+    NTSequence6AA flanked6AA(flanked);
+    CHECK(localAligner.scoreOnly(ref, flanked6AA).score
+	  == localAligner.align(ref, flanked6AA).score, failures);
+  }
+
+  if (failures > 0)
+    std::cerr << failures << " checks failed" << std::endl;
+
+  return failures > 0 ? 1 : 0;
+}
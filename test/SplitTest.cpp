@@ -0,0 +1,126 @@
+/*
+ * Copyright Emweb BVBA, 3020 Herent, Belgium
+ *
+ * See LICENSE.txt for terms of use.
+ */
+
+#include "GlobalAligner.h"
+#include "TestData.h"
+
+typedef GlobalAligner<GenomeScorer, Genome, NTSequence6AA, 3> Aligner;
+
+/*
+ * The cells that the alignment aligns as a match, every spacing
+ * reference positions.
+ */
+std::vector<SplitPoint> matchPoints(const Cigar& alignment, int spacing)
+{
+  std::vector<SplitPoint> result;
+
+  int refI = 0, queryI = 0, last = 0;
+  for (const auto& item : alignment) {
+    for (int k = 0; k < item.length(); ++k) {
+      switch (item.op()) {
+      case CigarItem::Match:
+	if (refI - last >= spacing) {
+	  result.push_back(SplitPoint(refI, queryI));
+	  last = refI;
+	}
+	++refI;
+	++queryI;
+	break;
+      case CigarItem::QueryGap:
+      case CigarItem::RefSkipped:
+	++refI;
+	break;
+      default:
+	++queryI;
+      }
+    }
+  }
+
+  return result;
+}
+
+/* Whether the alignment aligns the point as a match */
+bool alignsAsMatch(const Cigar& alignment, const SplitPoint& p)
+{
+  int refI = 0, queryI = 0;
+  for (const auto& item : alignment) {
+    for (int k = 0; k < item.length(); ++k) {
+      switch (item.op()) {
+      case CigarItem::Match:
+	if (refI == p.refPos && queryI == p.queryPos)
+	  return true;
+	++refI;
+	++queryI;
+	break;
+      case CigarItem::QueryGap:
+      case CigarItem::RefSkipped:
+	++refI;
+	break;
+      default:
+	++queryI;
+      }
+    }
+  }
+
+  return false;
+}
+
+/*
+ * Splits the alignment of queries at points of their optimal
+ * alignment, and checks that aligning through these points gives the
+ * same alignment, with one or more threads, in the full matrix and in
+ * a band. A point that is not on the optimal alignment is still
+ * aligned as a match.
+ */
+int main(int argc, char **argv)
+{
+  TestData data(11);
+
+  Genome ref = data.genome(4000);
+
+  int failures = 0;
+
+  for (int q = 0; q < 3; ++q) {
+    const int length = q == 0 ? ref.size() : data.uniform(1000, 3000);
+    const int start = data.uniform(0, ref.size() - length);
+    NTSequence6AA query(data.query(ref, start, length));
+
+    Aligner aligner(data.genomeScorer());
+    const SearchRange full(ref.size() + 1, query.size() + 1);
+    const Aligner::Solution expected = aligner.align(ref, query, full);
+
+    const SearchRange band
+      = getSearchRange(expected.cigar, ref.size(), query.size(), 60);
+
+    std::vector<SplitPoint> points = matchPoints(expected.cigar, 300);
+    CHECK(points.size() > 2, failures);
+
+    for (int threads : { 1, 4 }) {
+      aligner.setThreads(threads);
+
+      for (const SearchRange& sr : { full, band }) {
+	Aligner::Solution solution = aligner.alignThrough(ref, query, sr, points);
+	CHECK(solution.score == expected.score, failures);
+	CHECK(solution.cigar.str() == expected.cigar.str(), failures);
+      }
+    }
+
+    /* Move a point off the optimal alignment */
+    std::vector<SplitPoint> shifted = points;
+    SplitPoint& p = shifted[shifted.size() / 2];
+    p.queryPos += 2;
+
+    Aligner::Solution solution = aligner.alignThrough(ref, query, full, shifted);
+    CHECK(solution.score < expected.score, failures);
+    for (const auto& point : shifted)
+      CHECK(alignsAsMatch(solution.cigar, point), failures);
+  }
+
+  if (failures > 0)
+    std::cerr << failures << " checks failed" << std::endl;
+
+  return failures > 0 ? 1 : 0;
+}
@@ -0,0 +1,133 @@
+// This may look like C code, but it's really -*- C++ -*-
+/*
+ * Copyright Emweb BVBA, 3020 Herent, Belgium
+ *
+ * See LICENSE.txt for terms of use.
+ */
+#ifndef TEST_DATA_H_
+#define TEST_DATA_H_
+
+#include <iostream>
+#include <random>
+#include <string>
+
+#include "Genome.h"
+#include "GenomeScorer.h"
+#include "SimpleScorer.h"
+#include "SubstitutionMatrix.h"
+
+/*
+ * Random test data: a reference genome with a CDS, queries derived
+ * from it, and the scorers with the default options of aga.
+ */
+class TestData
+{
+public:
+  TestData(unsigned seed)
+    : random_(seed),
+      ntScorer_(ntScoreMatrix(2, -2), -10, -1, 0, 0),
+      aaScorer_(SubstitutionMatrix::BLOSUM30(), -6, -2, -100, -20),
+      genomeScorer_(ntScorer_, aaScorer_, 1, 1)
+  { }
+
+  /*
+   * A linear genome of the given length, with a CDS from position 100
+   * up to about 100 positions before its end.
+   */
+  Genome genome(int length) {
+    std::string s = sequence(100);
+    s += "ATG";
+    while ((int)s.size() < length - 103)
+      s += codon();
+    s += "TAA";
+    const int cdsEnd = s.size();
+    s += sequence(length - s.size());
+
+    Genome result(seq::NTSequence("ref", "", s), Genome::Geometry::Linear);
+    result.addCdsFeature(CdsFeature("A", "101.." + std::to_string(cdsEnd)));
+    result.preprocess(genomeScorer_);
+
+    return result;
+  }
+
+  /*
+   * The positions [start, start + length) of the reference with
+   * random substitutions, insertions and deletions.
+   */
+  seq::NTSequence query(const seq::NTSequence& ref, int start, int length,
+			double substitutions = 0.08, double indels = 0.005) {
+    std::uniform_real_distribution<double> p(0, 1);
+
+    std::string s;
+    for (int i = start; i < start + length; ++i) {
+      double r = p(random_);
+      if (r < substitutions)
+	s += sequence(1);
+      else if (r < substitutions + indels)
+	continue;
+      else {
+	s += ref[i].toChar();
+	if (r < substitutions + 2 * indels)
+	  s += sequence(1);
+      }
+    }
+
+    return seq::NTSequence("query", "", s);
+  }
+
+  int uniform(int min, int max) {
+    return std::uniform_int_distribution<int>(min, max)(random_);
+  }
+
+  const GenomeScorer& genomeScorer() const { return genomeScorer_; }
+  const SimpleScorer<seq::NTSequence>& ntScorer() const { return ntScorer_; }
+
+private:
+  std::mt19937 random_;
+  SimpleScorer<seq::NTSequence> ntScorer_;
+  SimpleScorer<seq::AASequence> aaScorer_;
+  GenomeScorer genomeScorer_;
+
+  std::string sequence(int length) {
+    static const char nucleotides[] = "ACGT";
+    std::string result;
+    for (int i = 0; i < length; ++i)
+      result += nucleotides[uniform(0, 3)];
+    return result;
+  }
+
+  std::string codon() {
+    for (;;) {
+      std::string c = sequence(3);
+      if (c != "TAA" && c != "TAG" && c != "TGA")
+	return c;
+    }
+  }
+
+  /* As in aga, leaked since the scorers keep a pointer to it */
+  static const int **ntScoreMatrix(int M, int E) {
+    const int **matrix = new const int *[4];
+    for (int i = 0; i < 4; ++i) {
+      int *row = new int[4];
+      for (int j = 0; j < 4; ++j)
+	row[j] = i == j ? M : E;
+      matrix[i] = row;
+    }
+
+    return matrix;
+  }
+};
+
+/*
+ * Reports a failed check, and counts it in failures.
+ */
+#define CHECK(condition, failures)					\
+  do {									\
+    if (!(condition)) {							\
+      std::cerr << __FILE__ << ":" << __LINE__				\
+		<< ": check failed: " #condition << std::endl;		\
+      ++(failures);							\
+    }									\
+  } while (0)
+
+#endif // TEST_DATA_H_
@@ -0,0 +1,78 @@
+/*
+ * Copyright Emweb BVBA, 3020 Herent, Belgium
+ *
+ * See LICENSE.txt for terms of use.
+ */
+
+#include "GlobalAligner.h"
+#include "TestData.h"
+
+typedef GlobalAligner<GenomeScorer, Genome, NTSequence6AA, 3> Aligner;
+
+/*
+ * Aligns the query in a single thread, and in tiles with several
+ * threads, within the memory limit, and checks that these give the
+ * same alignment.
+ */
+int checkTiled(const TestData& data, const Genome& ref,
+	       const NTSequence6AA& query, const SearchRange& sr,
+	       unsigned long memoryLimit)
+{
+  int failures = 0;
+
+  Aligner aligner(data.genomeScorer());
+  aligner.setMemoryLimit(memoryLimit);
+
+  const Aligner::Solution expected = aligner.align(ref, query, sr);
+  const unsigned stripeColumns = aligner.stripeColumns();
+
+  for (int threads : { 2, 3, 5 }) {
+    aligner.setThreads(threads);
+    const Aligner::Solution solution = aligner.align(ref, query, sr);
+    CHECK(aligner.stripeColumns() == stripeColumns, failures);
+    CHECK(solution.score == expected.score, failures);
+    CHECK(solution.cigar.str() == expected.cigar.str(), failures);
+  }
+
+  return failures;
+}
+
+/*
+ * Rows are split in blocks of at least 1024 rows, and of more rows
+ * for a long query with few threads. A low memory limit gives stripes
+ * narrower than a tile (256 columns).
+ */
+int main(int argc, char **argv)
+{
+  TestData data(17);
+
+  const unsigned long noLimit = 1000UL * 1000 * 1000;
+
+  int failures = 0;
+
+  /* Blocks of 1475 rows with 2 threads, and of 1024 rows with more */
+  Genome ref = data.genome(6000);
+  NTSequence6AA query(data.query(ref, 50, 5900));
+  failures += checkTiled(data, ref, query, SearchRange(), noLimit);
+
+  /* Also in a band, and in stripes of 225 columns (600 in the band) */
+  Genome small = data.genome(1800);
+  const int start = 100, length = 1650;
+  NTSequence6AA part(data.query(small, start, length));
+
+  Cigar seed;
+  seed.push_back(CigarItem(CigarItem::RefSkipped, start));
+  seed.push_back(CigarItem(CigarItem::Match, length));
+  seed.push_back(CigarItem(CigarItem::RefSkipped,
+			   small.size() - start - length));
+  const SearchRange band = getSearchRange(seed, small.size(), part.size(), 100);
+
+  for (unsigned long limit : { noLimit, 1UL })
+    for (const SearchRange& sr : { SearchRange(), band })
+      failures += checkTiled(data, small, part, sr, limit);
+
+  if (failures > 0)
+    std::cerr << failures << " checks failed" << std::endl;
+
+  return failures > 0 ? 1 : 0;
+}
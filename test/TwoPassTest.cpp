@@ -0,0 +1,107 @@
+/*
+ * Copyright Emweb BVBA, 3020 Herent, Belgium
+ *
+ * See LICENSE.txt for terms of use.
+ */
+
+#include "GlobalAligner.h"
+#include "CodonAligner.h"
+#include "TestData.h"
+
+typedef GlobalAligner<GenomeScorer, Genome, NTSequence6AA, 3> Aligner;
+
+typedef SimpleScorer<seq::NTSequence> NtScorer;
+typedef GlobalAligner<NtScorer, seq::NTSequence, seq::NTSequence,
+		      NtScorer::SideN> NtAligner;
+
+/* Whether every cell on the path of the alignment is within the range */
+bool inside(const Cigar& alignment, const SearchRange& sr)
+{
+  int hi = 0, hj = 0;
+  for (const auto& item : alignment) {
+    for (int k = 0; k < item.length(); ++k) {
+      switch (item.op()) {
+      case CigarItem::Match:
+	++hi;
+	++hj;
+	break;
+      case CigarItem::QueryGap:
+      case CigarItem::RefSkipped:
+	++hi;
+	break;
+      default:
+	++hj;
+      }
+
+      if (hj < sr.startRow(hi) || hj >= sr.endRow(hi))
+	return false;
+    }
+  }
+
+  return true;
+}
+
+/*
+ * Aligns the query in a band around the first pass, and checks that
+ * this alignment stays inside the band, and that it is the alignment
+ * of a single pass for these similar queries.
+ */
+int checkSecondPass(const TestData& data, const Genome& ref,
+		    const NTSequence6AA& query, const Cigar& firstPass,
+		    const Aligner::Solution& expected)
+{
+  const int band = 50;
+
+  int failures = 0;
+
+  const SearchRange sr
+    = getSearchRange(bandSeed(firstPass), ref.size(), query.size(), band);
+  CHECK(inside(firstPass, sr), failures);
+
+  Aligner aligner(data.genomeScorer());
+  const Aligner::Solution solution = aligner.align(ref, query, sr);
+  CHECK(inside(solution.cigar, sr), failures);
+  CHECK(solution.score == expected.score, failures);
+  CHECK(solution.cigar.str() == expected.cigar.str(), failures);
+
+  return failures;
+}
+
+/*
+ * Aligns queries in two passes, as aga --two-pass, with a first pass
+ * that has only the nucleotide scores, and with a coarse first pass
+ * at codon resolution (--codon-pass).
+ */
+int main(int argc, char **argv)
+{
+  TestData data(23);
+
+  Genome ref = data.genome(3000);
+
+  int failures = 0;
+
+  for (int q = 0; q < 4; ++q) {
+    const int length = data.uniform(1000, 2800);
+    const int start = data.uniform(0, ref.size() - length);
+    seq::NTSequence query = data.query(ref, start, length);
+    NTSequence6AA query6AA(query);
+
+    Aligner aligner(data.genomeScorer());
+    const Aligner::Solution expected = aligner.align(ref, query6AA);
+
+    NtAligner ntAligner(data.genomeScorer().nucleotideScorer());
+    failures += checkSecondPass(data, ref, query6AA,
+				ntAligner.align(ref, query).cigar, expected);
+
+    CodonAligner codonAligner(data.genomeScorer());
+    const SearchRange full(ref.size() + 1, query.size() + 1);
+    failures += checkSecondPass(data, ref, query6AA,
+				codonAligner.align(ref, query6AA, full),
+				expected);
+  }
+
+  if (failures > 0)
+    std::cerr << failures << " checks failed" << std::endl;
+
+  return failures > 0 ? 1 : 0;
+}
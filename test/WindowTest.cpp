@@ -0,0 +1,101 @@
+/*
+ * Copyright Emweb BVBA, 3020 Herent, Belgium
+ *
+ * See LICENSE.txt for terms of use.
+ */
+
+#include "GlobalAligner.h"
+#include "TestData.h"
+
+typedef GlobalAligner<GenomeScorer, Genome, NTSequence6AA, 3> Aligner;
+
+/*
+ * Aligns the query against the window of the reference around its
+ * seed, as aga does with --window, and checks that this gives the
+ * same alignment and score as against the whole reference. The seed
+ * starts at refStart, which may be shifted from the optimal alignment
+ * so that the search range is widened.
+ */
+int checkWindow(const TestData& data, const Genome& ref,
+		const seq::NTSequence& query, int refStart, int margin)
+{
+  int failures = 0;
+
+  const int querySize = query.size();
+  Cigar seed;
+  if (refStart > 0)
+    seed.push_back(CigarItem(CigarItem::RefSkipped, refStart));
+  seed.push_back(CigarItem(CigarItem::Match,
+			   std::min(querySize, (int)ref.size() - refStart)));
+  if (refStart + querySize < (int)ref.size())
+    seed.push_back(CigarItem(CigarItem::RefSkipped,
+			     ref.size() - refStart - querySize));
+  else if (refStart + querySize > (int)ref.size())
+    seed.push_back(CigarItem(CigarItem::QuerySkipped,
+			     refStart + querySize - ref.size()));
+
+  Aligner aligner(data.genomeScorer());
+  NTSequence6AA query6AA(query);
+
+  const SearchRange sr = getSearchRange(seed, ref.size(), querySize, margin);
+  const Aligner::Solution expected = aligner.align(ref, query6AA, sr);
+
+  int start, end;
+  sr.refWindow(margin + aligner.maxWidenedColumns() + 3, start, end);
+  CHECK(end - start < (int)ref.size(), failures);
+
+  Genome window = cropGenome(ref, start, end, data.genomeScorer());
+  const SearchRange windowSr = getSearchRange(seed.cropRef(start, end),
+					      window.size(), querySize, margin);
+  Aligner::Solution solution = aligner.align(window, query6AA, windowSr);
+
+  Cigar shifted;
+  shifted.push_back(CigarItem(CigarItem::RefSkipped, start));
+  shifted.insert(shifted.end(), solution.cigar.begin(), solution.cigar.end());
+  shifted.push_back(CigarItem(CigarItem::RefSkipped, ref.size() - end));
+  shifted.makeCanonical();
+
+  Cigar canonical = expected.cigar;
+  canonical.makeCanonical();
+
+  CHECK(solution.score * (ref.scoreFactor() / window.scoreFactor())
+	== expected.score, failures);
+  CHECK(shifted.str() == canonical.str(), failures);
+
+  return failures;
+}
+
+/*
+ * Amplicons of a large genome, also across the start and the end of
+ * its CDS, with the margins of a similar and a divergent query, and
+ * with a seed on the alignment or shifted from it by about the margin.
+ */
+int main(int argc, char **argv)
+{
+  TestData data(13);
+
+  Genome ref = data.genome(20000);
+
+  int failures = 0;
+
+  const int refSize = ref.size();
+
+  std::vector<int> starts = { 50, refSize - 700 };
+  for (int q = 0; q < 4; ++q)
+    starts.push_back(data.uniform(0, refSize - 2000));
+
+  for (int start : starts) {
+    const int length = std::min(data.uniform(600, 2000), refSize - start);
+    seq::NTSequence query = data.query(ref, start, length);
+
+    for (int margin : { 70, 150 })
+      for (int shift : { 0, margin + 5 })
+	failures += checkWindow(data, ref, query,
+				std::max(0, start - shift), margin);
+  }
+
+  if (failures > 0)
+    std::cerr << failures << " checks failed" << std::endl;
+
+  return failures > 0 ? 1 : 0;
+}
@@ -0,0 +1,44 @@
+/*
+ * Copyright Emweb BVBA, 3020 Herent, Belgium
+ *
+ * See LICENSE.txt for terms of use.
+ */
+
+#include "GlobalAligner.h"
+#include "TestData.h"
+
+/*
+ * Aligns a 12 kb query against its genome with X-drop, and checks that
+ * a large X-drop gives the alignment of the full matrix, while a small
+ * one drops cells of the optimal alignment and gives a worse one: X-drop
+ * is a heuristic.
+ */
+int main(int argc, char **argv)
+{
+  TestData data(2);
+
+  Genome ref = data.genome(12000);
+  NTSequence6AA query(data.query(ref, 0, ref.size()));
+
+  typedef GlobalAligner<GenomeScorer, Genome, NTSequence6AA, 3> Aligner;
+  Aligner aligner(data.genomeScorer());
+
+  const Aligner::Solution expected = aligner.align(ref, query);
+
+  int failures = 0;
+
+  /* As aga --x-drop, in weighted nucleotide score units */
+  aligner.setXDrop(200 * ref.scoreFactor());
+  Aligner::Solution solution = aligner.align(ref, query);
+  CHECK(solution.score == expected.score, failures);
+  CHECK(solution.cigar.str() == expected.cigar.str(), failures);
+
+  aligner.setXDrop(50 * ref.scoreFactor());
+  solution = aligner.align(ref, query);
+  CHECK(solution.score < expected.score, failures);
+
+  if (failures > 0)
+    std::cerr << failures << " checks failed" << std::endl;
+
+  return failures > 0 ? 1 : 0;
+}